@@ -4,18 +4,19 @@
 #include <iostream>
 
 int main() {
-  Lexer lexer = Lexer();
   std::string line;
-  std::map<std::string, Value> variables;
+  Env variables;
 
-  variables["len"] = nullptr;
-  variables["pop"] = nullptr;
-  variables["push"] = nullptr;
+  variables[SYM_LEN] = nullptr;
+  variables[SYM_POP] = nullptr;
+  variables[SYM_PUSH] = nullptr;
 
   while (std::getline(std::cin, line)) {
     try {
-      InfixParser infixParser = InfixParser(lexer.lexer(line), variables);
-      std::cout << infixParser.toString() << std::endl << infixParser.calculate() << std::endl;
+      // a lexer per line so the source it keeps for the tokens is freed with them
+      Lexer lexer = Lexer();
+      InfixParser infixParser = InfixParser(lexer.lexer(line));
+      std::cout << infixParser.toString() << std::endl << infixParser.calculate(variables) << std::endl;
     }
 
     catch (const std::exception& e) {
@@ -1,15 +1,35 @@
 #include <vector>
 #include <iostream>
 #include <string>
+#include <sstream>
+#include <stdexcept>
 #include "lib/infix.h"
 #include "lib/lexer.h"
 #include "lib/value.h"
 
-void format(std::vector<Token>& tokens, std::string indent) {
+// returns the index of the "}" closing the block opened at tokens[open]
+// the lexer already recorded the offset, so nested blocks are not rescanned
+size_t closeOf(TokenSpan tokens, size_t open) {
+  if (open >= tokens.size() || tokens[open].match <= 0 || open + tokens[open].match >= tokens.size()) {
+    const Token& token = open < tokens.size() ? tokens[open] : tokens.back();
+    std::ostringstream error;
+    error << "Unexpected token at line " << token.line << " column " << token.column << ": " << token.token;
+    throw std::runtime_error(error.str());
+  }
+
+  return open + tokens[open].match;
+}
+
+// returns the index of the first "{" at or after i
+size_t openOf(TokenSpan tokens, size_t i) {
+  while (i < tokens.size() && tokens[i].token != "{") ++i;
+  return i;
+}
+
+void format(TokenSpan tokens, std::string indent) {
   size_t ifCounter = 0;
-  std::map<std::string, Value> variables;
 
-  // loops through the entire vector of tokens
+  // loops through the entire span of tokens
   for (size_t i = 0; i < tokens.size(); ++i) {
     // end case
     if (tokens[i].type == END) break;
@@ -17,11 +37,11 @@ void format(std::vector<Token>& tokens, std::string indent) {
 
     // expression, print, and return case
     // prints return/print then treats it as a normal expression
-    if ((tokens[i].type != COMMAND && tokens[i].type != FUNCTION) || tokens[i].token == "print") {
-      if (tokens[i].token == "print") {
+    if ((tokens[i].type != COMMAND && tokens[i].type != FUNCTION) || tokens[i].symbol == SYM_PRINT) {
+      if (tokens[i].symbol == SYM_PRINT) {
         std::cout << "print";
 
-	if (tokens[i + 1].token == ";") {
+	if (i + 1 < tokens.size() && tokens[i + 1].token == ";") {
           std::cout << ";" << std::endl;
 	  continue;
 	}
@@ -31,10 +51,10 @@ void format(std::vector<Token>& tokens, std::string indent) {
 	++i;
       }
 
-      else if (tokens[i].token == "return") {
+      else if (tokens[i].symbol == SYM_RETURN) {
         std::cout << "return";
 
-        if (tokens[i + 1].token == ";") {
+        if (i + 1 < tokens.size() && tokens[i + 1].token == ";") {
           std::cout << ";" << std::endl;
 	  ++i;
           continue;
@@ -45,29 +65,22 @@ void format(std::vector<Token>& tokens, std::string indent) {
 	++i;
       }
 
-      std::vector<Token> tempTokens{tokens[i]};
+      size_t start = i;
       ++i;
 
-      while (i != tokens.size() && tokens[i].token != ";") {
-	tempTokens.push_back(tokens[i]);
-	++i;
-      }
+      while (i < tokens.size() && tokens[i].token != ";") ++i;
 
-      if (i != tokens.size()) {
-        tempTokens.push_back(tokens[i]);
-        tempTokens.back().token = "END";
-        tempTokens.back().type = END;
-      }
+      // the ';' stands in for END so errors point at it
+      Token end{0, 0, "END", END};
+      if (i < tokens.size()) end = Token{tokens[i].line, tokens[i].column, "END", END};
 
-      else tempTokens.push_back({0, 0, "END", END});
-
-      InfixParser parser = InfixParser(tempTokens, variables);
+      InfixParser parser = InfixParser(tokens.slice(start, i), end);
       std::cout << parser.toString() << ";" << std::endl;
     }
 
     // while, if, and def case
-    else if (tokens[i].token != "else" && tokens[i].token != "else if") {
-      if (tokens[i].token == "if") {
+    else if (tokens[i].symbol != SYM_ELSE && tokens[i].symbol != SYM_ELSE_IF) {
+      if (tokens[i].symbol == SYM_IF) {
         if (ifCounter != 0) {
 	  // Not checked
 	}
@@ -76,43 +89,25 @@ void format(std::vector<Token>& tokens, std::string indent) {
         ++ifCounter;
       }	
 
-      else if (tokens[i].token == "while") std::cout << "while ";
+      else if (tokens[i].symbol == SYM_WHILE) std::cout << "while ";
 
       else std::cout << "def ";
 
       // parsing condition or argument
-      ++i;
-      std::vector<Token> condition;
-
-      while (tokens[i].token != "{") {
-        condition.push_back(tokens[i]);
-	++i;
-      }
-      condition.push_back(Token{0, 0, "END", END});
+      size_t open = openOf(tokens, i + 1);
+      size_t close = closeOf(tokens, open);
 
-      ++i;
-      InfixParser parser = InfixParser(condition, variables);
+      InfixParser parser = InfixParser(tokens.slice(i + 1, open), Token{0, 0, "END", END});
       std::cout << parser.toString() << " {" << std::endl;
 
       // parsing function body
-      size_t numCurly = 1;
-      std::vector<Token> body;
-
-      while (true) {
-	if (tokens[i].token == "{") ++numCurly;
-	else if (tokens[i].token == "}") --numCurly;
-
-        if (numCurly == 0) break;
-        body.push_back(tokens[i]);
-	++i;
-      }
-
-      format(body, indent + "    ");
+      format(tokens.slice(open + 1, close), indent + "    ");
       std::cout << indent << "}" << std::endl;
+      i = close;
     }
 
     // else case
-    else if (tokens[i].token == "else" || tokens[i].token == "else if") {
+    else if (tokens[i].symbol == SYM_ELSE || tokens[i].symbol == SYM_ELSE_IF) {
       if (ifCounter == 0) {
         // Not checked
       }
@@ -120,50 +115,27 @@ void format(std::vector<Token>& tokens, std::string indent) {
       --ifCounter;
       std::cout << "else {" << std::endl;
 
-      bool isElseIf = (tokens[i].token == "else if" ? true : false);
-      size_t numCurly = 1;
-      std::vector<Token> body;
-
-      ++i;
-
-      // else if case needs to include if condition
-      // this loop does this
-      if (isElseIf) {
-        body.push_back(Token{0, 0, "if", COMMAND});
-
-	while (tokens[i].token != "{") {
-	  body.push_back(tokens[i]);
-	  ++i;
-	}
+      size_t open = openOf(tokens, i + 1);
+      size_t close = closeOf(tokens, open);
 
-	body.push_back(tokens[i]);
+      if (tokens[i].symbol == SYM_ELSE) {
+        format(tokens.slice(open + 1, close), indent + "    ");
       }
 
-      ++i;
-
-      while (true) {
-        if (tokens[i].token == "{") ++numCurly;
-        else if (tokens[i].token == "}") --numCurly;
-
-        if (numCurly == 0) {
-	  if (!isElseIf || i == tokens.size() - 1 || (tokens[i + 1].token != "else" && tokens[i + 1].token != "else if")) break;
-
-	  // else if case needs to consider whether or not the following command is else or else if
-	  // if it is, it needs to be included before called recursively
-	  while (tokens[i + 1].token != "{") {
-            body.push_back(tokens[i]);
-	    ++i;
-	  }
-	}
+      // else if is written as an if nested in the else
+      // any else or else if chained after it moves inside as well
+      else {
+        while (close + 1 < tokens.size() && (tokens[close + 1].symbol == SYM_ELSE || tokens[close + 1].symbol == SYM_ELSE_IF)) {
+          close = closeOf(tokens, openOf(tokens, close + 1));
+        }
 
-        body.push_back(tokens[i]);
-        ++i;
+        std::vector<Token> body{Token{0, 0, "if", COMMAND, SYM_IF}};
+        body.insert(body.end(), tokens.begin() + i + 1, tokens.begin() + close + 1);
+        format(body, indent + "    ");
       }
 
-      if (isElseIf) body.push_back(tokens[i]);
-
-      format(body, indent + "    ");
       std::cout << indent << "}" << std::endl;
+      i = close;
     }
 
     else {
@@ -173,12 +145,13 @@ void format(std::vector<Token>& tokens, std::string indent) {
   }
 }
 
-int main() {
+int main(int argc, char* argv[]) {
+  // outlives the tokens, see Lexer::sources
+  Lexer lexer = Lexer();
   std::vector<Token> tokens;
 
   try {
-    Lexer lexer = Lexer();
-    tokens = lexer.lexer();
+    tokens = argc > 1 ? lexer.lexFile(argv[1]) : lexer.lexer();
   }
   catch (const std::exception& e) {
     std::cout << e.what() << std::endl;
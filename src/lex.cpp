@@ -3,12 +3,49 @@
 #include <iomanip>
 #include <vector>
 #include <fstream>
+#include <limits>
+#include <stdexcept>
 #include "lib/lexer.h"
 
-int main() {
+// reads the N of --jobs=N, false unless it is a whole number above 0 that fits an unsigned
+bool readJobs(const std::string& digits, unsigned& jobs) {
+    if (digits.empty() || digits.find_first_not_of("0123456789") != std::string::npos) return false;
+
+    unsigned long count;
+    try {
+        count = std::stoul(digits);
+    }
+    catch (const std::out_of_range&) {
+        return false;
+    }
+
+    if (count == 0 || count > std::numeric_limits<unsigned>::max()) return false;
+    jobs = (unsigned)count;
+    return true;
+}
+
+// usage: lex [--jobs=N] [file]
+// --jobs caps the threads a large file is lexed with, --jobs=1 is the plain serial lexer
+// a bad --jobs exits 2 without lexing anything
+int main(int argc, char* argv[]) {
+    const char* path = nullptr;
+    unsigned jobs = 0;
+
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg.rfind("--jobs=", 0) == 0) {
+            if (!readJobs(arg.substr(7), jobs)) {
+                std::cerr << "lex: --jobs needs a whole number of threads above 0, not " << arg.substr(7) << std::endl;
+                return 2;
+            }
+        }
+        else path = argv[i];
+    }
+
     try{
         Lexer lexer = Lexer();
-        std::vector<Token> seq= lexer.lexer();
+        lexer.setThreads(jobs);
+        std::vector<Token> seq = path != nullptr ? lexer.lexFile(path) : lexer.lexer();
         for(int i = 0; i < (int)(seq.size()); i++){
             std::cout << std::right << std::setw(4) << seq.at(i).line << std::right << std::setw(5) << seq.at(i).column << "  " << seq.at(i).token<<std::endl;
         }
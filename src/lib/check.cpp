@@ -0,0 +1,67 @@
+#include "check.h"
+#include "lexer.h"
+#include "run.h"
+#include <algorithm>
+#include <atomic>
+#include <stdexcept>
+#include <thread>
+
+// 0 threads means one per core
+Checker::Checker(unsigned threads) {
+    if (threads == 0) threads = std::thread::hardware_concurrency();
+    this->threads = threads == 0 ? 1 : threads;
+}
+
+//Lexes with the given function, then reads the tokens into statements
+template <typename Lex>
+static CheckResult check(const std::string& path, Lex lex) {
+    CheckResult result;
+    result.path = path;
+
+    // outlives the tokens, see Lexer::sources
+    Lexer lexer = Lexer();
+    lexer.setThreads(1);
+    std::vector<Token> tokens;
+
+    try {
+        tokens = lex(lexer);
+    }
+    catch (const std::exception& e) {
+        result.errors.push_back(e.what());
+        result.lexError = true;
+        return result;
+    }
+
+    Scrypt scrypt = Scrypt();
+    result.errors = scrypt.check(tokens);
+    return result;
+}
+
+CheckResult Checker::checkFile(const std::string& path) const {
+    return check(path, [&path](Lexer& lexer) { return lexer.lexFile(path); });
+}
+
+CheckResult Checker::checkInput() const {
+    return check("", [](Lexer& lexer) { return lexer.lexer(); });
+}
+
+//Results come back in the order of paths, whichever thread checked them
+std::vector<CheckResult> Checker::checkFiles(const std::vector<std::string>& paths) const {
+    std::vector<CheckResult> results(paths.size());
+    std::atomic<size_t> next{0};
+
+    auto work = [&]() {
+        for (size_t i = next++; i < paths.size(); i = next++) {
+            results[i] = checkFile(paths[i]);
+        }
+    };
+
+    std::vector<std::thread> workers;
+    size_t count = std::min<size_t>(threads, paths.size());
+    for (size_t i = 1; i < count; i++) workers.emplace_back(work);
+
+    work();
+    for (std::thread& worker : workers) worker.join();
+
+    return results;
+}
@@ -0,0 +1,26 @@
+#ifndef CHECK_H
+#define CHECK_H
+#include <string>
+#include <vector>
+
+// The syntax errors found in one script, a lexer error stops the script at that point
+struct CheckResult {
+    std::string path;
+    std::vector<std::string> errors;
+    bool lexError = false;
+};
+
+// Validates scripts without running them: each one is lexed and read into statements, nothing is evaluated
+// Files are spread over threads, each file is lexed on a single thread
+class Checker {
+    private:
+        unsigned threads = 1;
+    public:
+        Checker(unsigned threads = 0);
+
+        CheckResult checkFile(const std::string& path) const;
+        CheckResult checkInput() const;
+        std::vector<CheckResult> checkFiles(const std::vector<std::string>& paths) const;
+};
+
+#endif
@@ -0,0 +1,43 @@
+#include "compiler.h"
+#include "stmt.h"
+
+Compiler::Compiler() {
+    worker = std::thread(&Compiler::run, this);
+}
+
+// Bodies still queued are left for their first call, the one being compiled is finished first
+Compiler::~Compiler() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+
+    wake.notify_one();
+    worker.join();
+}
+
+void Compiler::add(std::shared_ptr<const FunctionBody> body) {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        queue.push_back(std::move(body));
+    }
+
+    wake.notify_one();
+}
+
+void Compiler::run() {
+    while (true) {
+        std::shared_ptr<const FunctionBody> body;
+
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            wake.wait(lock, [this]() { return stopping || !queue.empty(); });
+            if (stopping) return;
+
+            body = std::move(queue.front());
+            queue.pop_front();
+        }
+
+        body->get();
+    }
+}
@@ -0,0 +1,32 @@
+#ifndef COMPILER_H
+#define COMPILER_H
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+struct FunctionBody;
+
+// Reads function bodies into statements on a worker thread, in the order their defs were read,
+// so they are usually ready before the first call
+// a call that gets to a body first compiles it itself, one that gets there while the worker is on it waits (see FunctionBody::get)
+class Compiler {
+    private:
+        std::mutex mutex;
+        std::condition_variable wake;
+        std::deque<std::shared_ptr<const FunctionBody>> queue;
+        bool stopping = false;
+        std::thread worker;
+
+        void run();
+    public:
+        Compiler();
+        Compiler(const Compiler&) = delete;
+        Compiler& operator=(const Compiler&) = delete;
+        ~Compiler();
+
+        void add(std::shared_ptr<const FunctionBody> body);
+};
+
+#endif
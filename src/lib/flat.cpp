@@ -0,0 +1,713 @@
+#include "flat.h"
+#include "infix.h"
+#include "stmt.h"
+#include <iostream>
+#include <cmath>
+#include <deque>
+#include <sstream>
+#include <stdexcept>
+
+uint32_t FlatExpr::constant(Value value) {
+  constants.push_back(value);
+  return (uint32_t) constants.size() - 1;
+}
+
+uint32_t FlatExpr::name(const std::string& text) {
+  for (size_t i = 0; i < names.size(); ++i) {
+    if (names[i] == text) return (uint32_t) i;
+  }
+
+  names.push_back(text);
+  return (uint32_t) names.size() - 1;
+}
+
+void FlatExpr::emit(FlatOp op, uint32_t a, uint32_t b, uint8_t flags) {
+  FlatNode node;
+  node.op = op;
+  node.flags = flags;
+  node.a = a;
+  node.b = b;
+  nodes.push_back(node);
+}
+
+// whether a node always evaluates to a number
+static bool isNumber(Node* node) {
+  if (OpNode* opNode = dynamic_cast<OpNode*>(node)) return opNode->op >= OP_ADD && opNode->op <= OP_MOD;
+
+  return dynamic_cast<NumNode*>(node) != nullptr && node->lookUp == nullptr;
+}
+
+// lays the tree out operands first, with an explicit stack like the parser so deep trees are fine
+// each entry is either a node still to expand or an instruction ready to emit, pushed in reverse order
+FlatExpr::FlatExpr(Node* root) {
+  // label marks where the innermost F_SKIP still waiting for its target should jump to
+  struct Item {
+    Node* node;
+    FlatNode ready;
+    bool label;
+  };
+
+  std::vector<Item> work;
+  std::vector<size_t> skips;
+  auto ready = [&work](FlatOp op, uint32_t a = 0, uint32_t b = 0, uint8_t flags = 0) {
+    FlatNode node;
+    node.op = op;
+    node.flags = flags;
+    node.a = a;
+    node.b = b;
+    work.push_back({nullptr, node, false});
+  };
+  auto expand = [&work](Node* node) { work.push_back({node, FlatNode{F_CONST}, false}); };
+  auto label = [&work]() { work.push_back({nullptr, FlatNode{F_CONST}, true}); };
+
+  expand(root);
+
+  while (!work.empty()) {
+    Item item = work.back();
+    work.pop_back();
+
+    if (item.label) {
+      nodes[skips.back()].a = (uint32_t) nodes.size();
+      skips.pop_back();
+      continue;
+    }
+
+    if (item.node == nullptr) {
+      if (item.ready.op == F_SKIP) skips.push_back(nodes.size());
+      nodes.push_back(item.ready);
+      continue;
+    }
+
+    Node* node = item.node;
+
+    if (AssignNode* assign = dynamic_cast<AssignNode*>(node)) {
+      if (!(assign->lhs->isVar)) {
+        if (assign->lhs->lookUp == nullptr) {
+          emit(F_THROW, name("Runtime error: invalid assignee."));
+          continue;
+        }
+
+        ready(F_DROP_UNDER);
+        expand(assign->rhs);
+        expand(assign->lhs);
+      }
+
+      // element assignment checks the array and index before the value is evaluated
+      else if (assign->lhs->lookUp != nullptr) {
+        VarNode* key = (VarNode*) assign->lhs;
+
+        ready(F_STORE_ELEMENT);
+        expand(assign->rhs);
+        ready(F_CHECK_INDEX);
+        expand(key->lookUp);
+        ready(F_ELEMENT, key->symbol);
+      }
+
+      else {
+        ready(F_STORE, ((VarNode*) assign->lhs)->symbol);
+        expand(assign->rhs);
+      }
+    }
+
+    else if (OpNode* opNode = dynamic_cast<OpNode*>(node)) {
+      // & and | jump over their right side when the left one decides the result, leaving it as the value
+      // otherwise the value is the right side's
+      if (opNode->op == OP_AND || opNode->op == OP_OR) {
+        label();
+        ready(F_CHECK_BOOL);
+        expand(opNode->rhs);
+        ready(F_SKIP, 0, 0, opNode->op == OP_OR);
+        expand(opNode->lhs);
+        continue;
+      }
+
+      FlatOp op;
+
+      switch (opNode->op) {
+        case OP_ADD: op = F_ADD; break;
+        case OP_SUB: op = F_SUB; break;
+        case OP_MUL: op = F_MUL; break;
+        case OP_DIV: op = F_DIV; break;
+        case OP_MOD: op = F_MOD; break;
+        case OP_EQ: op = F_EQ; break;
+        case OP_NE: op = F_NE; break;
+        case OP_LT: op = F_LT; break;
+        case OP_GT: op = F_GT; break;
+        case OP_LE: op = F_LE; break;
+        case OP_GE: op = F_GE; break;
+        case OP_XOR: op = F_XOR; break;
+        default: throw std::runtime_error("Undefined operator");
+      }
+
+      ready(op);
+
+      // == and != have always run their right side first, the result does not depend on the order
+      if (op == F_EQ || op == F_NE) {
+        expand(opNode->lhs);
+        expand(opNode->rhs);
+        continue;
+      }
+
+      expand(opNode->rhs);
+
+      // a wrong left operand is reported before the right one is evaluated
+      // no check is needed when the left side is arithmetic or a plain number
+      if (op == F_XOR) ready(F_CHECK_BOOL);
+      else if (!isNumber(opNode->lhs)) ready(F_CHECK_NUMBER);
+
+      expand(opNode->lhs);
+    }
+
+    else if (VarNode* var = dynamic_cast<VarNode*>(node)) {
+      uint32_t id = var->symbol;
+      uint32_t count = (uint32_t) var->arguments.size();
+
+      // built in functions check their argument count before evaluating anything
+      if (var->symbol == SYM_LEN || var->symbol == SYM_POP || var->symbol == SYM_PUSH) {
+        uint32_t expected = var->symbol == SYM_PUSH ? 2 : 1;
+
+        if (count != expected) {
+          ready(F_THROW, name("Runtime error: incorrect argument count."));
+        }
+
+        else {
+          // push has always evaluated the element before the array, so it finds them the other way round
+          ready(var->symbol == SYM_LEN ? F_LEN : var->symbol == SYM_POP ? F_POP : F_PUSH);
+          for (size_t i = 0; i < count; ++i) expand(var->arguments[i]);
+        }
+
+        ready(F_LOAD, id, 0, LOAD_BUILTIN);
+      }
+
+      else if (var->lookUp != nullptr) {
+        ready(F_INDEX);
+        expand(var->lookUp);
+        ready(F_LOAD, id, 0, LOAD_LOOKUP);
+      }
+
+      else if (count != 0) {
+        ready(F_CALL, 0, count);
+        for (size_t i = count; i > 0; --i) expand(var->arguments[i - 1]);
+        ready(F_LOAD, id, count, LOAD_CALL);
+      }
+
+      else ready(F_LOAD, id, 0, var->noArgs ? LOAD_NO_ARGS : LOAD_PLAIN);
+    }
+
+    else if (ArrayNode* array = dynamic_cast<ArrayNode*>(node)) {
+      // indexing a literal only evaluates the element it picks
+      if (array->lookUp != nullptr) {
+        trees.push_back(array);
+        emit(F_TREE, (uint32_t) trees.size() - 1);
+        continue;
+      }
+
+      ready(F_ARRAY, 0, (uint32_t) array->value.size());
+      for (size_t i = array->value.size(); i > 0; --i) expand(array->value[i - 1]);
+    }
+
+    // numbers, bools and null
+    else {
+      if (node->lookUp != nullptr) emit(F_THROW, name("Runtime error: not an array."));
+      else emit(F_CONST, constant(node->value));
+    }
+  }
+
+  emit(F_END);
+}
+
+// copies another expression's nodes to the end of this one, without its F_END
+// its constants, names and trees move into this one's tables, so their indices and its jump targets are shifted
+void FlatExpr::append(const FlatExpr& expression) {
+  uint32_t start = (uint32_t) nodes.size();
+  uint32_t firstConstant = (uint32_t) constants.size();
+  uint32_t firstTree = (uint32_t) trees.size();
+
+  constants.insert(constants.end(), expression.constants.begin(), expression.constants.end());
+  trees.insert(trees.end(), expression.trees.begin(), expression.trees.end());
+
+  for (FlatNode node : expression.nodes) {
+    switch (node.op) {
+      case F_END: continue;
+      case F_CONST: node.a += firstConstant; break;
+      case F_TREE: node.a += firstTree; break;
+      case F_SKIP: node.a += start; break;
+      case F_THROW: node.a = name(expression.names[node.a]); break;
+      default: break;
+    }
+
+    nodes.push_back(node);
+  }
+}
+
+// pops the right operand and leaves the left one on top to be overwritten with the result
+static Value& numbers(std::vector<Value>& stack, double& l, double& r) {
+  Value rhs = std::move(stack.back());
+  stack.pop_back();
+  Value& lhs = stack.back();
+
+  if (!(lhs.isNumber() && rhs.isNumber())) throw std::runtime_error("Runtime error: invalid operand type.");
+
+  l = lhs.number();
+  r = rhs.number();
+  return lhs;
+}
+
+// a call the VM went into without leaving run, and where its caller picks up again once it returns
+struct FlatCall {
+  const FlatExpr* code;
+  size_t next;
+  size_t base;
+  // where the callee's frame starts, the function that was called sits just below it
+  size_t frame;
+  Env variables;
+};
+
+// the value of a single expression
+Value FlatExpr::evaluate(Env& variables) const {
+  Value result;
+  run(variables, result);
+  return result;
+}
+
+// with GCC and Clang each instruction jumps straight to the next one's code through a table of labels,
+// elsewhere a loop around a switch does the same
+#if defined(__GNUC__)
+#define FLAT_GOTO
+#endif
+
+// a computed goto out of an instruction's block skips the destructors of its locals, so an instruction
+// moves whatever it still holds onto the stack (or into a variable) before NEXT
+#ifdef FLAT_GOTO
+#define OP(op) L_##op:
+#define NEXT() do { node = &code->nodes[next++]; goto *labels[node->op]; } while (0)
+#else
+#define OP(op) case op:
+#define NEXT() break
+#endif
+
+// runs the nodes in order over a value stack shared by everything running on this thread
+// a function call runs its body on top of the caller's values, so positions are used instead of references
+// calls to functions the VM defined do not nest run either, it switches to the callee's code and keeps the
+// caller's place in calls, which lives on the heap, so recursion is only bounded by maxCallDepth
+// returns true when a return statement ran, result is then its value, otherwise an expression's value (blocks leave none)
+bool FlatExpr::run(Env& scope, Value& result) const {
+  // a deque, because variables points into the running call's record while a tree node can start a nested run
+  // that pushes more of them, and a deque does not move its elements when it grows or shrinks at the end
+  thread_local std::deque<FlatCall> calls;
+  std::vector<Value>& stack = valueStack();
+  size_t entry = calls.size();
+  size_t start = stack.size();
+
+  // what is running now, these change as the VM goes into and out of calls
+  const FlatExpr* code = this;
+  Env* variables = &scope;
+  size_t base = start;
+  size_t next = 0;
+  const FlatNode* node;
+
+  // the arguments of the call being started, and the value of the one being left
+  size_t count = 0;
+  Value returning;
+
+  try {
+#ifdef FLAT_GOTO
+#define FLAT_LABEL(op) &&L_##op,
+    static const void* const labels[F_COUNT] = {FLAT_OPS(FLAT_LABEL)};
+#undef FLAT_LABEL
+    NEXT();
+#else
+    while (true) {
+      node = &code->nodes[next++];
+
+      switch (node->op) {
+#endif
+        OP(F_CONST) {
+          stack.push_back(code->constants[node->a]);
+          NEXT();
+        }
+
+        OP(F_THROW) {
+          throw std::runtime_error(code->names[node->a]);
+        }
+
+        OP(F_LOAD) {
+          const Value* found = variables->find(node->a);
+
+          if (found == nullptr) {
+            std::ostringstream error;
+            error << "Runtime error: unknown identifier " << Symbols::name(node->a);
+            throw std::runtime_error(error.str());
+          }
+
+          if (node->flags == LOAD_BUILTIN) NEXT();
+
+          Value varData = *found;
+
+          if (varData.isArray()) {
+            if (node->flags == LOAD_CALL) throw std::runtime_error("Runtime error: not a function.");
+          }
+
+          else if (varData.isFunction()) {
+            if (node->flags == LOAD_LOOKUP) throw std::runtime_error("Runtime error: not an array.");
+            if (node->flags == LOAD_NO_ARGS) {
+              stack.push_back(std::move(varData));
+              count = 0;
+              goto call;
+            }
+          }
+
+          else {
+            if (node->flags == LOAD_LOOKUP) throw std::runtime_error("Runtime error: not an array.");
+            if (node->flags == LOAD_CALL) throw std::runtime_error("Runtime error: not a function.");
+          }
+
+          stack.push_back(std::move(varData));
+          NEXT();
+        }
+
+        OP(F_INDEX) {
+          const List& tempArray = *stack[stack.size() - 2].array();
+          Value element = tempArray.get(tempArray.index(stack.back()));
+          stack.pop_back();
+          stack.back() = std::move(element);
+          NEXT();
+        }
+
+        // the arguments on top of the stack become the first slots of the callee's frame
+        // the function stays under them until it returns, which keeps it alive
+        OP(F_CALL) {
+          count = node->b;
+        call:
+          {
+            Function* function = stack[stack.size() - count - 1].function();
+
+            // a function the tree engine defined runs its statements through Function::call
+            if (!function->vm) {
+              Value returned = function->call(count);
+              stack.back() = std::move(returned);
+              NEXT();
+            }
+
+            const FunctionBody& body = *function->body;
+            size_t frame = stack.size() - count;
+
+            if (body.arguments.size() != count) throw std::runtime_error("Runtime error: incorrect argument count.");
+
+            if (body.get().statements.empty()) {
+              stack.resize(frame);
+              stack.back() = nullptr;
+              NEXT();
+            }
+
+            const FlatExpr& callee = body.code();
+
+            // a tail call replaces the frame of the function making it, which returns whatever the callee does anyway
+            // so a loop written as tail recursion runs in constant space, the caller's place is kept as it was
+            if (node->tail && calls.size() > entry) {
+              FlatCall& current = calls.back();
+              std::move(stack.end() - count - 1, stack.end(), stack.begin() + (current.frame - 1));
+              frame = current.frame;
+              stack.resize(frame + count);
+              stack.resize(frame + body.layout.symbols.size(), Func());
+              current.variables = Env(function->variables, body.layout, stack, frame);
+            }
+
+            // the same frame Function::call would make, see there
+            else {
+              enterCall();
+              stack.resize(frame + body.layout.symbols.size(), Func());
+              calls.push_back(FlatCall{code, next, base, frame, Env(function->variables, body.layout, stack, frame)});
+            }
+
+            variables = &calls.back().variables;
+            (*variables)[body.symbol] = Func(function);
+
+            code = &callee;
+            base = stack.size();
+            next = 0;
+            NEXT();
+          }
+        }
+
+        OP(F_LEN) {
+          stack.back() = len(stack.back());
+          NEXT();
+        }
+
+        OP(F_POP) {
+          stack.back() = pop(stack.back());
+          NEXT();
+        }
+
+        OP(F_PUSH) {
+          Value array = std::move(stack.back());
+          stack.pop_back();
+          stack.back() = push(std::move(array), stack.back());
+          NEXT();
+        }
+
+        OP(F_ARRAY) {
+          Array tempArray = makeRef<List>(stack.end() - node->b, stack.end());
+          stack.resize(stack.size() - node->b);
+          stack.push_back(std::move(tempArray));
+          NEXT();
+        }
+
+        OP(F_ADD) {
+          double l, r;
+          Value& lhs = numbers(stack, l, r);
+          lhs = l + r;
+          NEXT();
+        }
+
+        OP(F_SUB) {
+          double l, r;
+          Value& lhs = numbers(stack, l, r);
+          lhs = l - r;
+          NEXT();
+        }
+
+        OP(F_MUL) {
+          double l, r;
+          Value& lhs = numbers(stack, l, r);
+          lhs = l * r;
+          NEXT();
+        }
+
+        OP(F_DIV) {
+          double l, r;
+          Value& lhs = numbers(stack, l, r);
+          if (r == 0) throw std::runtime_error("Runtime error: division by zero.");
+          lhs = l / r;
+          NEXT();
+        }
+
+        OP(F_MOD) {
+          double l, r;
+          Value& lhs = numbers(stack, l, r);
+          lhs = std::fmod(l, r);
+          NEXT();
+        }
+
+        OP(F_EQ) {
+          bool equal = stack[stack.size() - 2] == stack.back();
+          stack.pop_back();
+          stack.back() = equal;
+          NEXT();
+        }
+
+        OP(F_NE) {
+          bool equal = stack[stack.size() - 2] == stack.back();
+          stack.pop_back();
+          stack.back() = !equal;
+          NEXT();
+        }
+
+        OP(F_LT) {
+          double l, r;
+          Value& lhs = numbers(stack, l, r);
+          lhs = l < r;
+          NEXT();
+        }
+
+        OP(F_GT) {
+          double l, r;
+          Value& lhs = numbers(stack, l, r);
+          lhs = l > r;
+          NEXT();
+        }
+
+        OP(F_LE) {
+          double l, r;
+          Value& lhs = numbers(stack, l, r);
+          lhs = l <= r;
+          NEXT();
+        }
+
+        OP(F_GE) {
+          double l, r;
+          Value& lhs = numbers(stack, l, r);
+          lhs = l >= r;
+          NEXT();
+        }
+
+        OP(F_SKIP) {
+          if (!(stack.back().isBool())) throw std::runtime_error("Runtime error: invalid operand type.");
+
+          if (stack.back().boolean() == (bool) node->flags) next = node->a;
+          else stack.pop_back();
+          NEXT();
+        }
+
+        OP(F_XOR) {
+          Value rhs = std::move(stack.back());
+          stack.pop_back();
+          Value& lhs = stack.back();
+
+          if (!(lhs.isBool() && rhs.isBool())) throw std::runtime_error("Runtime error: invalid operand type.");
+
+          bool l = lhs.boolean();
+          bool r = rhs.boolean();
+
+          lhs = (l || r) && !(r && r);
+          NEXT();
+        }
+
+        OP(F_STORE) {
+          (*variables)[node->a] = stack.back();
+          NEXT();
+        }
+
+        OP(F_ELEMENT) {
+          const Value* found = variables->find(node->a);
+          if (found == nullptr || !(found->isArray())) throw std::runtime_error("Runtime error: not an array.");
+
+          stack.push_back(*found);
+          NEXT();
+        }
+
+        OP(F_CHECK_INDEX) {
+          stack[stack.size() - 2].array()->index(stack.back());
+          NEXT();
+        }
+
+        OP(F_STORE_ELEMENT) {
+          Value data = std::move(stack.back());
+          stack.pop_back();
+          size_t index = (size_t) stack.back().number();
+          stack.pop_back();
+
+          stack.back().array()->set(index, data);
+          stack.back() = std::move(data);
+          NEXT();
+        }
+
+        OP(F_DROP_UNDER) {
+          Value top = std::move(stack.back());
+          stack.pop_back();
+          stack.back() = std::move(top);
+          NEXT();
+        }
+
+        OP(F_TREE) {
+          Value value = code->trees[node->a]->getValue(*variables);
+          stack.push_back(std::move(value));
+          NEXT();
+        }
+
+        OP(F_CHECK_NUMBER) {
+          if (!(stack.back().isNumber())) throw std::runtime_error("Runtime error: invalid operand type.");
+          NEXT();
+        }
+
+        OP(F_CHECK_BOOL) {
+          if (!(stack.back().isBool())) throw std::runtime_error("Runtime error: invalid operand type.");
+          NEXT();
+        }
+
+        OP(F_END) {
+          // the end of the body of a function the VM went into, it returns null
+          if (calls.size() > entry) {
+            returning = nullptr;
+            goto leave;
+          }
+
+          if (stack.size() > base) result = std::move(stack.back());
+          stack.resize(base);
+          return false;
+        }
+
+        // the rest are statements
+
+        OP(F_DROP) {
+          stack.pop_back();
+          NEXT();
+        }
+
+        OP(F_PRINT) {
+          std::cout << stack.back() << std::endl;
+          stack.pop_back();
+          NEXT();
+        }
+
+        OP(F_MESSAGE) {
+          std::cout << code->names[node->a] << std::endl;
+          NEXT();
+        }
+
+        OP(F_JUMP) {
+          next = node->a;
+          NEXT();
+        }
+
+        // jumps when the condition is false
+        OP(F_BRANCH) {
+          if (!(stack.back().isBool())) throw std::runtime_error("Runtime error: condition is not a bool.");
+
+          bool condition = stack.back().boolean();
+          stack.pop_back();
+          if (!condition) next = node->a;
+          NEXT();
+        }
+
+        // every block starts with the built in functions' names set to null
+        OP(F_RESET) {
+          (*variables)[SYM_LEN] = nullptr;
+          (*variables)[SYM_POP] = nullptr;
+          (*variables)[SYM_PUSH] = nullptr;
+          NEXT();
+        }
+
+        OP(F_DEF) {
+          const DefStmt* def = code->defs[node->a];
+          Func function = makeRef<Function>(def->body, *variables);
+          function->vm = true;
+          (*variables)[def->body->symbol] = std::move(function);
+          NEXT();
+        }
+
+        // flags is set for a return without a value
+        OP(F_RETURN) {
+          if (calls.size() > entry) {
+            if (node->flags) returning = nullptr;
+            else returning = std::move(stack.back());
+            goto leave;
+          }
+
+          if (node->flags) result = nullptr;
+          else result = std::move(stack.back());
+          stack.resize(base);
+          return true;
+        }
+
+        // back to the caller of a function the VM went into, its value replaces the function on the stack
+      leave:
+        {
+          FlatCall& call = calls.back();
+          stack.resize(call.frame);
+          stack.back() = std::move(returning);
+
+          code = call.code;
+          base = call.base;
+          next = call.next;
+          calls.pop_back();
+          callDepth()--;
+          variables = calls.size() > entry ? &calls.back().variables : &scope;
+          NEXT();
+        }
+#ifndef FLAT_GOTO
+      }
+    }
+#endif
+  }
+  catch (...) {
+    callDepth() -= calls.size() - entry;
+    calls.erase(calls.begin() + entry, calls.end());
+    stack.resize(start);
+    throw;
+  }
+}
+
+#undef OP
+#undef NEXT
@@ -0,0 +1,75 @@
+#ifndef FLAT_H
+#define FLAT_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <map>
+#include "value.h"
+
+struct Node;
+struct DefStmt;
+
+// Opcodes of a FlatExpr, see FlatExpr::run for what each one does to the value stack
+// listed once here so the enum and the jump table in run always agree
+// the ones after F_END only show up in blocks compiled by the VM
+#define FLAT_OPS(X) \
+  X(F_CONST) X(F_THROW) X(F_LOAD) X(F_INDEX) X(F_CALL) X(F_LEN) X(F_POP) X(F_PUSH) X(F_ARRAY) \
+  X(F_ADD) X(F_SUB) X(F_MUL) X(F_DIV) X(F_MOD) X(F_EQ) X(F_NE) X(F_LT) X(F_GT) X(F_LE) X(F_GE) \
+  X(F_SKIP) X(F_XOR) X(F_STORE) X(F_ELEMENT) X(F_CHECK_INDEX) X(F_STORE_ELEMENT) X(F_DROP_UNDER) \
+  X(F_TREE) X(F_CHECK_NUMBER) X(F_CHECK_BOOL) X(F_END) \
+  X(F_DROP) X(F_PRINT) X(F_MESSAGE) X(F_JUMP) X(F_BRANCH) X(F_RESET) X(F_DEF) X(F_RETURN)
+
+#define FLAT_ENUM(op) op,
+enum FlatOp : uint8_t {
+  FLAT_OPS(FLAT_ENUM)
+  F_COUNT
+};
+#undef FLAT_ENUM
+
+// F_LOAD flags, the shape of the variable use decides which type errors it reports before its operands run
+enum FlatLoad : uint8_t {
+  LOAD_PLAIN,
+  LOAD_LOOKUP,
+  LOAD_CALL,
+  LOAD_NO_ARGS,
+  LOAD_BUILTIN
+};
+
+struct FlatNode {
+  FlatOp op;
+  uint8_t flags = 0;
+  // set by the VM on an F_CALL (or an F_LOAD calling without arguments) whose value is returned straight away
+  bool tail = false;
+  // constant, name, tree, def or jump target index, and for F_CALL, F_ARRAY and builtins the number of operands
+  uint32_t a = 0;
+  uint32_t b = 0;
+};
+
+// An expression tree laid out in evaluation order (operands before the node that uses them) in one vector
+// evaluated by a single loop over a value stack, so there are no virtual calls and no recursion
+// shapes that only evaluate some of their operands (an array literal that is indexed straight away) keep their tree node
+// the VM compiles whole blocks into one of these as well, with jumps for their loops and branches
+class FlatExpr {
+  std::vector<FlatNode> nodes;
+  std::vector<Value> constants;
+  std::vector<std::string> names;
+  std::vector<Node*> trees;
+  std::vector<const DefStmt*> defs;
+
+  uint32_t constant(Value value);
+  uint32_t name(const std::string& text);
+  void emit(FlatOp op, uint32_t a = 0, uint32_t b = 0, uint8_t flags = 0);
+  void append(const FlatExpr& expression);
+
+  friend class VM;
+
+public:
+  FlatExpr() {}
+  FlatExpr(Node* root);
+
+  Value evaluate(Env& variables) const;
+  bool run(Env& variables, Value& result) const;
+};
+
+#endif
@@ -7,435 +7,514 @@
 #include <iomanip>
 
 Value len(Value value) {
-  if (!std::holds_alternative<Array>(value)) throw std::runtime_error("Runtime error: not an array.");
+  if (!value.isArray()) throw std::runtime_error("Runtime error: not an array.");
 
-  return (double) std::get<Array>(value)->size();
+  return (double) value.array()->size();
 }
 
 Value pop(Value value) {
-  if (!std::holds_alternative<Array>(value)) throw std::runtime_error("Runtime error: not an array.");
+  if (!value.isArray()) throw std::runtime_error("Runtime error: not an array.");
 
-  Array tempArray = std::get<Array>(value);
+  List* tempArray = value.array();
 
   if (tempArray->size() == 0) throw std::runtime_error("Runtime error: underflow.");
 
-  Value last = tempArray->back();
-  tempArray->pop_back();
-  return last;
+  return tempArray->pop();
 }
 
 Value push(Value value, Value element) {
-  if (!std::holds_alternative<Array>(value)) throw std::runtime_error("Runtime error: not an array.");
+  if (!value.isArray()) throw std::runtime_error("Runtime error: not an array.");
 
-  std::get<Array>(value)->push_back(element);
+  value.array()->push(element);
   return nullptr;
 }
 
-InfixParser::InfixParser(std::vector<Token> tokens, std::map<std::string, Value>& variables) : varCache(variables) {
-  if (tokens.size() == 1) {
+InfixParser::InfixParser(TokenSpan tokens) : tokens(tokens) {
+  // expressions cut out of a larger script get an END one column past their last token
+  if (!tokens.empty() && tokens.back().type != END) endToken = Token{tokens.back().line, tokens.back().column + 1, "END", END};
+
+  parse();
+}
+
+InfixParser::InfixParser(TokenSpan tokens, Token end) : tokens(tokens), endToken(end) {
+  parse();
+}
+
+const Token& InfixParser::at(size_t i) const {
+  if (i < tokens.size()) return tokens[i];
+  return endToken;
+}
+
+void InfixParser::parse() {
+  length = tokens.size();
+  if (tokens.empty() || tokens.back().type != END) ++length;
+
+  if (length == 1) {
     std::ostringstream error;
-    error << "Unexpected token at line " << tokens[0].line << " column " << tokens[0].column << ": " << tokens[0].token;
+    error << "Unexpected token at line " << at(0).line << " column " << at(0).column << ": " << at(0).token;
     throw std::runtime_error(error.str());
   }
 
-  if (tokens[0].type == OPERATOR || tokens[0].type == ASSIGNMENT || tokens[0].token == ")") {
+  if (at(0).type == OPERATOR || at(0).type == ASSIGNMENT || at(0).token == ")") {
     std::ostringstream error;
-    error << "Unexpected token at line " << tokens[0].line << " column " << tokens[0].column << ": " << tokens[0].token;
+    error << "Unexpected token at line " << at(0).line << " column " << at(0).column << ": " << at(0).token;
     throw std::runtime_error(error.str());
   }
 
   // creating the tree starts here
   // nextNode is called to get the first token
   // uses precedence of 0 as a base condition
-  root = createTree(nextNode(tokens), 0, tokens);
+  root.reset(parseExpression());
 
   if (parenNum != 0) {
-    delete root;
     std::ostringstream error;
-    error << "Unexpected token at line " << tokens[tokens.size() - 1].line << " column " << tokens[tokens.size() - 1].column << ": " << tokens[tokens.size() - 1].token;
+    error << "Unexpected token at line " << at(length - 1).line << " column " << at(length - 1).column << ": " << at(length - 1).token;
     throw std::runtime_error(error.str());
   }
 
   index = 0;
+  flat = FlatExpr(root.get());
 }
 
-InfixParser::~InfixParser() {
-  delete root;
+// one pending createTree or nextNode call of the precedence climbing parser
+// they are kept on an explicit stack so the nesting depth of an expression is only limited by memory
+// state says where the call continues once the call above it has returned its node
+struct ParseFrame {
+  bool tree;
+  int state = 0;
+
+  // createTree: the operands around currOp, nextNode: node is the operand being built
+  std::unique_ptr<Node> lhs;
+  std::unique_ptr<Node> rhs;
+  std::unique_ptr<Node> node;
+  int minPrecedence = 0;
+  const Token* currOp = nullptr;
+  const Token* nextOp = nullptr;
+  size_t parenNumBuffer = 0;
+
+  // nextNode: the token being looked at and the scan over call arguments or array elements
+  size_t i = 0;
+  size_t j = 0;
+  size_t parens = 0;
+  size_t brackets = 0;
+  bool validSyntax = false;
+
+  // a createTree call, needLhs fetches its first operand with nextNode first
+  static ParseFrame createTree(Node* lhs, int minPrecedence, bool needLhs) {
+    ParseFrame frame;
+    frame.tree = true;
+    frame.lhs.reset(lhs);
+    frame.minPrecedence = minPrecedence;
+    frame.state = needLhs ? TREE_START : TREE_PEAK;
+    return frame;
+  }
+
+  static ParseFrame nextNode(size_t from) {
+    ParseFrame frame;
+    frame.tree = false;
+    frame.i = from;
+    frame.state = NODE_SCAN;
+    return frame;
+  }
+
+  enum {
+    TREE_START, TREE_LHS, TREE_PEAK, TREE_LOOP, TREE_RHS, TREE_INNER, TREE_INNER_DONE,
+    NODE_SCAN, NODE_LOOKUP, NODE_ARGS, NODE_ARG, NODE_LAST_ARG, NODE_PAREN, NODE_ELEMENTS, NODE_ELEMENT, NODE_LAST_ELEMENT, NODE_ARRAY_END
+  };
+};
+
+static std::runtime_error unexpected(const Token& token) {
+  std::ostringstream error;
+  error << "Unexpected token at line " << token.line << " column " << token.column << ": " << token.token;
+  return std::runtime_error(error.str());
 }
 
-// creates the actual tree from the given vector of tokens
-// look at the precedence helper function to see the precedence of each operator
-// several try-catch to prevent memory leaks
-// read within the try statements for the core lines
+// creates the actual tree from the stored tokens
+// look at OPERATORS in token.h to see the precedence of each operator
 // operator precedence parsing: https://en.wikipedia.org/wiki/Operator-precedence_parser#Pseudocode
-Node* InfixParser::createTree(Node* leftHandSide, int minPrecedence, std::vector<Token> tokens) {
-  std::string nextOp;
-
-  // gets the first operator
-  try {
-    nextOp = peak(tokens).token;
-  }
-  catch (const std::exception& e){
-    delete leftHandSide;
-    throw std::runtime_error(e.what());
-  }
-
-  // goes through the vector until an operator of lower precedence is reached
-  while (precedence(nextOp) >= minPrecedence) {
-    std::string currOp = nextOp;
-    Node* rightHandSide;
-
-    try {
-      rightHandSide = nextNode(tokens);
-    }
-    catch (const std::exception& e) {
-      delete leftHandSide;
-      throw std::runtime_error(e.what());
-    }
+// createTree(lhs, min) and nextNode() below are the two kinds of ParseFrame, the comments name the recursive version's steps
+Node* InfixParser::parseExpression() {
+  std::vector<ParseFrame> stack;
+  // the node returned by the frame that was just popped
+  std::unique_ptr<Node> result;
+
+  // createTree(nextNode(), 0)
+  auto subExpression = [&stack]() { stack.push_back(ParseFrame::createTree(nullptr, 0, true)); };
+
+  stack.push_back(ParseFrame::createTree(nullptr, 0, true));
+
+  while (!stack.empty()) {
+    ParseFrame& frame = stack.back();
+
+    switch (frame.state) {
+      // createTree ______________________________________________________________________________________________________
+      case ParseFrame::TREE_START:
+        frame.state = ParseFrame::TREE_LHS;
+        stack.push_back(ParseFrame::nextNode(index + 1));
+        break;
+
+      case ParseFrame::TREE_LHS:
+        frame.lhs = std::move(result);
+        frame.state = ParseFrame::TREE_PEAK;
+        break;
+
+      // gets the first operator
+      case ParseFrame::TREE_PEAK:
+        frame.nextOp = &peak();
+        frame.state = ParseFrame::TREE_LOOP;
+        break;
+
+      // goes through the tokens until an operator of lower precedence is reached
+      case ParseFrame::TREE_LOOP:
+        if (precedence(*frame.nextOp) >= frame.minPrecedence) {
+          frame.currOp = frame.nextOp;
+          frame.state = ParseFrame::TREE_RHS;
+          stack.push_back(ParseFrame::nextNode(index + 1));
+        }
 
-    try {
-      nextOp = peak(tokens).token;
-    }
-    catch (const std::exception& e) {
-      delete leftHandSide;
-      delete rightHandSide;
-      throw std::runtime_error(e.what());
-    }
+        else {
+          result = std::move(frame.lhs);
+          stack.pop_back();
+        }
+        break;
+
+      case ParseFrame::TREE_RHS:
+        frame.rhs = std::move(result);
+        frame.nextOp = &peak();
+        frame.state = ParseFrame::TREE_INNER;
+        break;
+
+      // deals with higher precedence operators to the right, and right associative ones (assignment) of the same precedence
+      case ParseFrame::TREE_INNER: {
+        int next = precedence(*frame.nextOp);
+        int curr = precedence(*frame.currOp);
+        bool right = OPERATORS[frame.nextOp->op].rightAssociative;
+
+        if (next > curr || (right && next == curr)) {
+          frame.parenNumBuffer = parenNum;
+          frame.state = ParseFrame::TREE_INNER_DONE;
+          Node* rhs = frame.rhs.release();
+          stack.push_back(ParseFrame::createTree(rhs, curr + (right ? 0 : 1), false));
+          break;
+        }
 
-    // this while loop deals with higher precedence operators to the right through recursion
-    // second part of the or statement and the addedPrecedence variable are to parse assignment which is righ associative
-    while ((precedence(nextOp) > precedence(currOp)) || (nextOp == "=" && precedence(nextOp) == precedence(currOp))) {
-      int addedPrecedence = 1;
-      if (nextOp == "=") --addedPrecedence;
-      size_t parenNumBuffer = parenNum;
+        // below connects the parts of tree
+        OpNode* tempNode;
+        Op op = frame.currOp->op;
 
-      try {
-        rightHandSide = createTree(rightHandSide, precedence(currOp) + addedPrecedence, tokens);
-      }
-      catch (const std::exception& e) {
-	delete leftHandSide;
-	throw std::runtime_error(e.what());
-      }
+        if (op == OP_ASSIGN) tempNode = new AssignNode;
+        else if (op >= OP_EQ && op <= OP_GE) tempNode = new CompareNode;
+        else if (op >= OP_OR && op <= OP_AND) tempNode = new LogicNode;
+        else tempNode = new OpNode;
 
-      parenNum = parenNumBuffer;
+        tempNode->value = std::string(frame.currOp->token);
+        tempNode->op = op;
+        tempNode->lhs = frame.lhs.release();
+        tempNode->rhs = frame.rhs.release();
 
-      try {      
-	nextOp = peak(tokens).token;
-      }
-      catch (const std::exception& e) {
-        delete leftHandSide;
-        delete rightHandSide;
-        throw std::runtime_error(e.what());
+        frame.lhs.reset(tempNode);
+        frame.state = ParseFrame::TREE_LOOP;
+        break;
       }
-    }
-
-    // below connects the parts of tree
-    OpNode* tempNode;
-
-    if (currOp == "=") tempNode = new AssignNode;
-    else if (currOp == "==" || currOp == "!=" || currOp == ">" || currOp == "<" || currOp == ">=" || currOp == "<=") tempNode = new CompareNode;
-    else if (currOp == "|" || currOp == "^" || currOp == "&") tempNode = new LogicNode;
-    else tempNode = new OpNode;
-
-    tempNode->value = currOp;
-    tempNode->lhs = leftHandSide;
-    tempNode->rhs = rightHandSide;
-
-    if (currOp == "=") {
-      variableBuffer.push_back({leftHandSide, rightHandSide});
-    }
-
-    leftHandSide = tempNode;
-  }
-
-  return leftHandSide;
-}
-
-// helper function to retrieve precedence
-int InfixParser::precedence(std::string op) {
-  if (op == "=") return 0;
-
-  else if (op == "|") return 1;
-
-  else if (op == "^") return 2;
-
-  else if (op == "&") return 3;
 
-  else if (op == "==" || op == "!=") return 4;
-
-  else if (op == "<" || op == ">" || op == "<=" || op == ">=") return 5;
-
-  else if (op == "+" || op == "-") return 6;
-
-  else if (op == "*" || op == "/" || op == "%") return 7;
+      case ParseFrame::TREE_INNER_DONE:
+        frame.rhs = std::move(result);
+        parenNum = frame.parenNumBuffer;
+        frame.nextOp = &peak();
+        frame.state = ParseFrame::TREE_INNER;
+        break;
+
+      // nextNode ________________________________________________________________________________________________________
+      // finds the next number, variable, parenthesis or array after index
+      case ParseFrame::NODE_SCAN: {
+        size_t i = frame.i;
+
+        for (; i < length; ++i) {
+          if (at(i).type == NUMBER || at(i).type == BOOL || at(i).type == NILL || at(i).type == VARIABLE) break;
+          if (at(i).token == "(" || at(i).token == "[" || at(i).type == COMMAND) break;
+        }
 
-  else if (op == "END" || op == ")" || op == "," || op == "]") return -1;
+        if (i >= length) throw unexpected(at(length - 1));
+        frame.i = i;
 
-  else {
-    throw std::runtime_error("Undefined operator");
-  }
-}
+        if (at(i).type == NUMBER || at(i).type == BOOL || at(i).type == NILL) {
+          if (at(i + 1).type == NUMBER || at(i + 1).type == VARIABLE || at(i + 1).type == BOOL || at(i + 1).token == "(") throw unexpected(at(i + 1));
+          else if (i != 0 && at(i - 1).token == ")") throw unexpected(at(i - 1));
 
-// returns the next operator given the stored index member variable
-// considers closing parenthesis and END as operators
-// deals with errors
-Token& InfixParser::peak(std::vector<Token> tokens) {
-  for (size_t i = index + 1; i < tokens.size(); ++i) {
-    if (tokens[i].type == OPERATOR || tokens[i].type == ASSIGNMENT || tokens[i].type == COMPARE || tokens[i].type == LOGIC || tokens[i].type == COMMA) {
-
-      if (tokens[i - 1].token == "(") {
-        std::ostringstream error;
-        error << "Unexpected token at line " << tokens[i].line << " column " << tokens[i].column << ": " << tokens[i].token;
-	throw std::runtime_error(error.str());
-      }
+          index = i;
 
-      else if (tokens[i + 1].type == OPERATOR || tokens[i + 1].type == ASSIGNMENT || tokens[i + 1].type == COMPARE || tokens[i + 1].type == LOGIC || tokens[i + 1].token == ")" || tokens[i + 1].type == END) {
-        std::ostringstream error;
-        error << "Unexpected token at line " << tokens[i + 1].line << " column " << tokens[i + 1].column << ": " << tokens[i + 1].token;
-	throw std::runtime_error(error.str());
-      }
+          if (at(i).type == NUMBER) frame.node.reset(new NumNode);
+          else if (at(i).type == BOOL) frame.node.reset(new BoolNode);
+          else frame.node.reset(new NullNode);
 
-      return tokens[i];
-    }
+          frame.node->value = stringToValue(at(i));
 
-    else if (tokens[i].token == ")") {
-      if (parenNum == 0) {
-        std::ostringstream error;
-        error << "Unexpected token at line " << tokens[i].line << " column " << tokens[i].column << ": " << tokens[i].token;
-	throw std::runtime_error(error.str());
-      }
+          if (at(i + 1).token == "[") {
+            ++index;
+            frame.state = ParseFrame::NODE_LOOKUP;
+            subExpression();
+            break;
+          }
 
-      if (tokens[i + 1].token == "(") {
-        std::ostringstream error;
-	error << "Unexpected token at line " << tokens[i + 1].line << " column " << tokens[i + 1].column << ": " << tokens[i + 1].token;
-	throw std::runtime_error(error.str());
-      }
+          result = std::move(frame.node);
+          stack.pop_back();
+        }
 
-      --parenNum;
-      return tokens[i];
-    }
+        else if (at(i).type == VARIABLE) {
+          if (at(i + 1).type == NUMBER || at(i + 1).type == VARIABLE || at(i + 1).type == BOOL) throw unexpected(at(i + 1));
+          else if (i != 0 && at(i - 1).token == ")") throw unexpected(at(i));
+
+          index = i;
+
+          VarNode* tempNode = new VarNode;
+          frame.node.reset(tempNode);
+          tempNode->value = at(i).token;
+          tempNode->symbol = at(i).symbol;
+
+          // Accounting for array lookup
+          if (at(index + 1).token == "[") {
+            ++index;
+            frame.state = ParseFrame::NODE_LOOKUP;
+            subExpression();
+            break;
+          }
+
+          // Accounting for function arguments
+          else if (at(index + 1).token == "(") {
+            ++index;
+            tempNode->isVar = false;
+
+            if (at(index + 1).token == ")") {
+              tempNode->noArgs = true;
+              ++index;
+            }
+
+            else {
+              frame.parens = 1;
+              frame.brackets = 0;
+              frame.j = index + 1;
+              frame.validSyntax = false;
+              frame.state = ParseFrame::NODE_ARGS;
+              break;
+            }
+          }
+
+          result = std::move(frame.node);
+          stack.pop_back();
+        }
 
-    else if (tokens[i].token == "]") {
-      // assuming valid pairing
+        // creates a tree for parenthesis case
+        else if (at(i).token == "(") {
+          if (at(i + 1).token == ")" || at(i + 1).type == OPERATOR || at(i + 1).type == ASSIGNMENT || at(i + 1).type == COMMA) throw unexpected(at(i + 1));
 
-      return tokens[i];
-    }
-  }
+          index = i;
+          ++parenNum;
+          frame.state = ParseFrame::NODE_PAREN;
+          subExpression();
+        }
 
-  // returns END token
-  return tokens.back();
-}
+        // array literal
+        // definitely more error cases that could be added to this as well as "(" case (such as type == logic or comparison)
+        else if (at(i).token == "[") {
+          index = i;
+          frame.node.reset(new ArrayNode);
+          frame.brackets = 1;
+          frame.parens = 0;
+          frame.j = index + 1;
+          frame.state = ParseFrame::NODE_ELEMENTS;
+        }
 
-// returns the next number or variable given the stored index member variable
-// calls createTree with base parameters when it hits an open parenthesis
-// deals with errors
-Node* InfixParser::nextNode(std::vector<Token> tokens) {
-  for (size_t i = index + 1; i < tokens.size(); ++i) {
-    if (tokens[i].type == NUMBER || tokens[i].type == BOOL || tokens[i].type == NILL) {
-
-      if (tokens[i + 1].type == NUMBER || tokens[i + 1].type == VARIABLE || tokens[i + 1].type == BOOL || tokens[i + 1].token == "(") {
-        std::ostringstream error;
-        error << "Unexpected token at line " << tokens[i + 1].line << " column " << tokens[i + 1].column << ": " << tokens[i + 1].token;
-	throw std::runtime_error(error.str());
-      }
+        else throw unexpected(at(i));
 
-      else if (i != 0 && tokens[i - 1].token == ")") {
-        std::ostringstream error;
-        error << "Unexpected token at line " << tokens[i - 1].line << " column " << tokens[i - 1].column << ": " << tokens[i - 1].token;
-	throw std::runtime_error(error.str());
+        break;
       }
 
-      index = i;
-
-      Node* tempNode;
-
-      if (tokens[i].type == NUMBER) tempNode = new NumNode;
-      else if (tokens[i].type == BOOL) tempNode = new BoolNode;
-      else tempNode = new NullNode;
-
-      tempNode->value = stringToValue(tokens[i]);
-
-      if (tokens[i + 1].token == "[") {
-        ++index;
-        tempNode->lookUp = createTree(nextNode(tokens), 0, tokens);
+      case ParseFrame::NODE_LOOKUP:
+        frame.node->lookUp = result.release();
         ++index;
-      }
+        result = std::move(frame.node);
+        stack.pop_back();
+        break;
+
+      // counts the arguments of a call, each top level comma parses the argument before it
+      case ParseFrame::NODE_ARGS: {
+        bool comma = false;
+
+        while (at(frame.j).type != END) {
+          // nested groups the lexer matched are skipped in one step
+          if (at(frame.j).match > 0 && frame.j + at(frame.j).match < tokens.size()) {
+            frame.j += at(frame.j).match + 1;
+            frame.validSyntax = true;
+            continue;
+          }
+
+          if (at(frame.j).token == "(") ++frame.parens;
+          else if (at(frame.j).token == ")") --frame.parens;
+          else if (at(frame.j).token == "[") ++frame.brackets;
+          else if (at(frame.j).token == "]") --frame.brackets;
+
+          if (frame.parens == 0) break;
+          else if (at(frame.j).type == COMMA && (frame.parens == 1 && frame.brackets == 0)) {
+            if (!(frame.validSyntax)) throw unexpected(at(frame.j));
+
+            comma = true;
+            break;
+          }
+
+          ++frame.j;
+          frame.validSyntax = true;
+        }
 
-      return tempNode;
-    }
+        if (comma) {
+          frame.state = ParseFrame::NODE_ARG;
+          subExpression();
+          break;
+        }
 
-    else if (tokens[i].type == VARIABLE) {
-      
-      if (tokens[i + 1].type == NUMBER || tokens[i + 1].type == VARIABLE || tokens[i + 1].type == BOOL /*|| tokens[i + 1].token == "("*/) {
-        std::ostringstream error;
-        error << "Unexpected token at line " << tokens[i + 1].line << " column " << tokens[i + 1].column << ": " << tokens[i + 1].token;
-	throw std::runtime_error(error.str());
-      }
+        if (!(frame.validSyntax)) throw unexpected(at(frame.j));
 
-      else if (i != 0 && tokens[i - 1].token == ")") {
-        std::ostringstream error;
-        error << "Unexpected token at line " << tokens[i].line << " column " << tokens[i].column << ": " << tokens[i].token;
-	throw std::runtime_error(error.str());
+        ++parenNum;
+        frame.state = ParseFrame::NODE_LAST_ARG;
+        subExpression();
+        break;
       }
 
-      index = i;
-
-      VarNode* tempNode = new VarNode;
-      tempNode->value = tokens[i].token;
+      case ParseFrame::NODE_ARG:
+        ((VarNode*) frame.node.get())->arguments.push_back(result.release());
+        frame.validSyntax = false;
+        ++frame.j;
+        frame.state = ParseFrame::NODE_ARGS;
+        break;
 
-      // Accounting for array lookup
-      if (tokens[index + 1].token == "[") {
+      case ParseFrame::NODE_LAST_ARG:
+        ((VarNode*) frame.node.get())->arguments.push_back(result.release());
         ++index;
-        tempNode->lookUp = createTree(nextNode(tokens), 0, tokens);
-        ++index;
-      }
+        result = std::move(frame.node);
+        stack.pop_back();
+        break;
 
-      // Accounting for function arguments
-      else if (tokens[index + 1].token == "(") {
+      case ParseFrame::NODE_PAREN:
         ++index;
-	tempNode->isVar = false;
-
-        if (tokens[index + 1].token == ")") {
-          tempNode->noArgs = true;
-	  ++index;
-	}
-        
-        else {
-          size_t argParenNum = 1;
-          size_t j = index + 1;
-	  size_t bracketNum = 0;
-	  size_t validSyntax = false;
-
-	  while (true) {
-	    if (tokens[j].token == "(") ++argParenNum;
-	    else if (tokens[j].token == ")") --argParenNum;
-	    else if (tokens[j].token == "[") ++bracketNum;
-	    else if (tokens[j].token == "]") --bracketNum;
-
-            if (argParenNum == 0) break;
-	    else if (tokens[j].type == COMMA && (argParenNum == 1 && bracketNum == 0)) {
-	      if (validSyntax) {
-	        tempNode->arguments.push_back(createTree(nextNode(tokens), 0, tokens));
-		validSyntax = false;
-		++j;
-		continue;
-	      }
-	      
-	      std::ostringstream error;
-              error << "Unexpected token at line " << tokens[j].line << " column " << tokens[j].column << ": " << tokens[j].token;
-	      delete tempNode;
-              throw std::runtime_error(error.str()); 
-	    }
-
-            ++j;
-	    validSyntax = true;
-	  }
-
-	  if (!(validSyntax)) {
-            std::ostringstream error;
-            error << "Unexpected token at line " << tokens[j].line << " column " << tokens[j].column << ": " << tokens[j].token;
-            delete tempNode;
-	    throw std::runtime_error(error.str());
-	  }
-	  
-	  ++parenNum;
-          tempNode->arguments.push_back(createTree(nextNode(tokens), 0, tokens));
-	  ++index;
-	}
-
-      }
-
-      // do not update stored variables when there is an error
-      if (tokens[i + 1].token != "=" && (tempNode->value != "push" && tempNode->value != "pop")/*&& !(std::holds_alternative<Func>(variables[tempNode->value]))*/) {
-        std::streambuf* coutBuffer = std::cout.rdbuf();
+        stack.pop_back();
+        break;
+
+      // counts the elements of an array literal, each top level comma parses the element before it
+      case ParseFrame::NODE_ELEMENTS: {
+        bool comma = false;
+
+        while (at(frame.j).type != END) {
+          if (at(frame.j).match > 0 && frame.j + at(frame.j).match < tokens.size()) {
+            frame.j += at(frame.j).match + 1;
+            continue;
+          }
+
+          if (at(frame.j).token == "[") ++frame.brackets;
+          else if (at(frame.j).token == "]") --frame.brackets;
+          else if (at(frame.j).token == "(") ++frame.parens;
+          else if (at(frame.j).token == ")") --frame.parens;
+
+          if (frame.brackets == 0) break;
+          else if (at(frame.j).type == COMMA && (frame.brackets == 1 && frame.parens == 0)) {
+            comma = true;
+            break;
+          }
+
+          ++frame.j;
+        }
 
-        try {
-	  std::stringstream tempStream;
-	  std::cout.rdbuf(tempStream.rdbuf());
+        if (comma) {
+          frame.state = ParseFrame::NODE_ELEMENT;
+          subExpression();
+        }
 
-	  tempNode->getValue(varCache);
-	}
-	catch (const std::exception& e) {
-	  updateVariables = false;
-	  std::cout.rdbuf(coutBuffer);
-	}
+        else if (frame.j != (size_t) index + 1) {
+          frame.state = ParseFrame::NODE_LAST_ELEMENT;
+          subExpression();
+        }
 
-	std::cout.rdbuf(coutBuffer);
+        else frame.state = ParseFrame::NODE_ARRAY_END;
+        break;
       }
 
-      return tempNode;
-    }
+      case ParseFrame::NODE_ELEMENT:
+        ((ArrayNode*) frame.node.get())->value.push_back(result.release());
+        ++frame.j;
+        frame.state = ParseFrame::NODE_ELEMENTS;
+        break;
 
-    else if (tokens[i].token == "(") {
-      if (tokens[i + 1].token == ")" || tokens[i + 1].type == OPERATOR || tokens[i + 1].type == ASSIGNMENT || tokens[i + 1].type == COMMA) {
-        std::ostringstream error;
-        error << "Unexpected token at line " << tokens[i + 1].line << " column " << tokens[i + 1].column << ": " << tokens[i + 1].token;
-	throw std::runtime_error(error.str());
-      }
-      
-      index = i;
-      ++parenNum;
+      case ParseFrame::NODE_LAST_ELEMENT:
+        ((ArrayNode*) frame.node.get())->value.push_back(result.release());
+        frame.state = ParseFrame::NODE_ARRAY_END;
+        break;
 
-      // creates a tree for parenthesis case
-      Node* tempNode = createTree(nextNode(tokens), 0, tokens);
+      // Parsing array lookup
+      case ParseFrame::NODE_ARRAY_END:
+        ++index;
 
-      ++index;
+        if (at(index + 1).token == "[") {
+          ++index;
+          frame.state = ParseFrame::NODE_LOOKUP;
+          subExpression();
+          break;
+        }
 
-      return tempNode;
+        result = std::move(frame.node);
+        stack.pop_back();
+        break;
     }
+  }
 
-    else if (tokens[i].token == "[") {
-      // add error cases from "("
-      // definitely more error cases that could be added to this as well as "(" case (such as type == logic or comparison)
-      index = i;
-
-      ArrayNode* tempNode = new ArrayNode;
-
-      size_t bracketNum = 1;
-      int j = index + 1;
-      size_t innerParenNum = 0;
+  return result.release();
+}
 
-      while (true) {
-        if (tokens[j].token == "[") ++bracketNum;
-	else if (tokens[j].token == "]") --bracketNum;
-        else if (tokens[j].token == "(") ++innerParenNum;
-	else if (tokens[j].token == ")") --innerParenNum;
+// helper function to retrieve precedence, END and the closing tokens stop every expression
+int InfixParser::precedence(const Token& op) const {
+  if (op.type == END) return -1;
 
-	if (bracketNum == 0) break;
-	else if (tokens[j].type == COMMA && (bracketNum == 1 && innerParenNum == 0)) tempNode->value.push_back(createTree(nextNode(tokens), 0, tokens));
+  int result = OPERATORS[op.op].precedence;
+  if (result < -1) throw std::runtime_error("Undefined operator");
 
-	++j;
-      }
+  return result;
+}
 
-      if (j != index + 1) tempNode->value.push_back(createTree(nextNode(tokens), 0, tokens));
+// returns the next operator given the stored index member variable
+// considers closing parenthesis and END as operators
+// deals with errors
+const Token& InfixParser::peak() {
+  for (size_t i = index + 1; i < length; ++i) {
+    if (at(i).type == OPERATOR || at(i).type == ASSIGNMENT || at(i).type == COMPARE || at(i).type == LOGIC || at(i).type == COMMA) {
 
-      ++index;
+      if (at(i - 1).token == "(") throw unexpected(at(i));
 
-      // Parsing array lookup
-      if (tokens[index + 1].token == "[") {
-        ++index;
-	tempNode->lookUp = createTree(nextNode(tokens), 0, tokens);
-	++index;
+      else if (at(i + 1).type == OPERATOR || at(i + 1).type == ASSIGNMENT || at(i + 1).type == COMPARE || at(i + 1).type == LOGIC || at(i + 1).token == ")" || at(i + 1).type == END) {
+        throw unexpected(at(i + 1));
       }
 
-      return tempNode;
+      return at(i);
     }
 
-    else if (tokens[i].type == COMMAND) {
-      std::ostringstream error;
-      error << "Unexpected token at line " << tokens[i].line << " column " << tokens[i].column << ": " << tokens[i].token;
-      throw std::runtime_error(error.str());
+    else if (at(i).token == ")") {
+      if (parenNum == 0) throw unexpected(at(i));
+      if (at(i + 1).token == "(") throw unexpected(at(i + 1));
+
+      --parenNum;
+      return at(i);
     }
 
+    else if (at(i).token == "]") {
+      // assuming valid pairing
+
+      return at(i);
+    }
   }
 
-  std::ostringstream error;
-  error << "Unexpected token at line " << tokens[tokens.size() - 1].line << " column " << tokens[tokens.size() - 1].column << ": " << tokens[tokens.size() - 1].token;
-  throw std::runtime_error(error.str());
+  // returns END token
+  return at(length - 1);
 }
 
-// helper function that converts a string from a token to data stored in the Value class
-Value InfixParser::stringToValue(Token& token) {
+// helper function that converts a token to data stored in the Value class
+// numbers were already converted by the lexer
+Value InfixParser::stringToValue(const Token& token) {
   Value result;
 
   if (token.type == BOOL) {
@@ -444,7 +523,7 @@ Value InfixParser::stringToValue(Token& token) {
   }
   
   else if (token.type == NUMBER) {
-    result = std::stod(token.token);
+    result = token.number;
   }
 
   
@@ -456,60 +535,43 @@ Value InfixParser::stringToValue(Token& token) {
   return result;
 }
 
-std::string InfixParser::toString() {
+std::string InfixParser::toString() const {
   return root->toString();
 }
 
-// updates the values of variables first before returning the root's getValue
-Value InfixParser::calculate() {
-  if (updateVariables) {
-    for (const auto& pair : variableBuffer) {
-      if (!(pair.first->isVar)) continue;
-
-      VarNode* key = (VarNode*) pair.first;
-      Node* data = pair.second;
-
-      if (key->arguments.size() != 0 || key->noArgs) continue;
-
-      // if the variable is already defined and has lookup
-      if (varCache.find(key->value) != varCache.end() && key->lookUp != nullptr) {
-        // checking if the variable is an array, and if so, we only want to change the value of a specific index
-        if (std::holds_alternative<Array>(varCache[key->value])) {
-          if (!(std::holds_alternative<double>(key->lookUp->getValue(varCache)))) throw std::runtime_error("Runtime error: index is not a number.");
-
-          double arrayIndex = std::get<double>(key->lookUp->getValue(varCache));
-          Array tempArray = std::get<Array>(varCache[key->value]);
+// the tree is only read here, so one parser can be calculated many times and re-entrantly
+// assignments happen as the tree is evaluated, each after its own right hand side
+Value InfixParser::calculate(Env& variables) const {
+  return flat.evaluate(variables);
+}
 
-          if (std::fmod(arrayIndex, 1) != 0) throw std::runtime_error("Runtime error: index is not an integer.");
-          if (arrayIndex >= tempArray->size() || arrayIndex < 0) throw std::runtime_error("Runtime error: index out of bounds.");
+// every variable an assignment in the tree stores to, element assignments only change the array
+void InfixParser::assigned(std::vector<int>& symbols) const {
+  std::vector<Node*> work = {root.get()};
 
-          tempArray->at(arrayIndex) = data->getValue(varCache);
-          continue;
-        }
+  while (!work.empty()) {
+    Node* node = work.back();
+    work.pop_back();
+    if (node == nullptr) continue;
+    if (node->lookUp != nullptr) work.push_back(node->lookUp);
 
-        else throw std::runtime_error("Runtime error: not an array.");
+    if (OpNode* opNode = dynamic_cast<OpNode*>(node)) {
+      if (dynamic_cast<AssignNode*>(opNode) && opNode->lhs->isVar && opNode->lhs->lookUp == nullptr) {
+        symbols.push_back(((VarNode*) opNode->lhs)->symbol);
       }
 
-      // if variable is not defined and has lookup
-      else if (varCache.find(key->value) == varCache.end() && key->lookUp != nullptr) throw std::runtime_error("Runtime error: not an array.");
-
-      std::streambuf* coutBuffer = std::cout.rdbuf();
-      std::stringstream tempStream;
-      std::cout.rdbuf(tempStream.rdbuf());
+      work.push_back(opNode->lhs);
+      work.push_back(opNode->rhs);
+    }
 
-      try {
-        data->getValue(varCache);
-        varCache[key->value] = data->getValue(varCache);
-      } catch (...) {
-        std::cout.rdbuf(coutBuffer);
-        continue;
-      }
+    else if (VarNode* var = dynamic_cast<VarNode*>(node)) {
+      work.insert(work.end(), var->arguments.begin(), var->arguments.end());
+    }
 
-      std::cout.rdbuf(coutBuffer);
+    else if (ArrayNode* array = dynamic_cast<ArrayNode*>(node)) {
+      work.insert(work.end(), array->value.begin(), array->value.end());
     }
   }
-
-  return root->getValue(varCache);
 }
 
 // Node class and its inherited classes's definitions start here
@@ -518,7 +580,7 @@ Node::~Node() {
   if (lookUp != nullptr) delete lookUp;
 }
 
-Value NumNode::getValue([[maybe_unused]] std::map<std::string, Value>& variables) {
+Value NumNode::getValue([[maybe_unused]] Env& variables) {
   if (lookUp != nullptr) throw std::runtime_error("Runtime error: not an array.");
 
   return value;
@@ -527,7 +589,7 @@ Value NumNode::getValue([[maybe_unused]] std::map<std::string, Value>& variables
 std::string NumNode::toString() {
   std::ostringstream result;
 
-  result << std::get<double>(value);
+  result << value.number();
 
   if (lookUp != nullptr) result << "[" << lookUp->toString() << "]";
 
@@ -542,77 +604,77 @@ VarNode::~VarNode() {
   }
 }
 
-Value VarNode::getValue([[maybe_unused]] std::map<std::string, Value>& variables) {
-  if(variables.find(value) == variables.end()){
+Value VarNode::getValue([[maybe_unused]] Env& variables) {
+  const Value* found = variables.find(symbol);
+
+  if(found == nullptr){
     std::ostringstream error;
     error <<"Runtime error: unknown identifier " << value;
     throw std::runtime_error(error.str());
   }
   
   // special cases for the built in functions
-  if (value == "len") {
+  if (symbol == SYM_LEN) {
     if (arguments.size() != 1) throw std::runtime_error("Runtime error: incorrect argument count.");
 
     return len(arguments[0]->getValue(variables));
   }
 
-  else if (value == "pop") {
+  else if (symbol == SYM_POP) {
     if (arguments.size() != 1) throw std::runtime_error("Runtime error: incorrect argument count.");
 
     return pop(arguments[0]->getValue(variables));
   }
 
-  else if (value == "push") {
+  else if (symbol == SYM_PUSH) {
     if (arguments.size() != 2) throw std::runtime_error("Runtime error: incorrect argument count.");
 
-    return push(arguments[0]->getValue(variables), arguments[1]->getValue(variables));
+    // the element has always been evaluated before the array
+    Value element = arguments[1]->getValue(variables);
+    return push(arguments[0]->getValue(variables), element);
   }
 
-  Value varData = variables[value];
+  Value varData = *found;
 
   // bool, double, and null case
-  if (std::holds_alternative<double>(varData) || std::holds_alternative<bool>(varData) || std::holds_alternative<std::nullptr_t>(varData)) {
+  if (varData.isNumber() || varData.isBool() || varData.isNull()) {
     if (lookUp != nullptr) throw std::runtime_error("Runtime error: not an array.");
     else if (arguments.size() != 0) throw std::runtime_error("Runtime error: not a function.");
     else return varData;
   }
 
   // array case
-  else if (std::holds_alternative<Array>(varData)) {
+  else if (varData.isArray()) {
     if (arguments.size() != 0) throw std::runtime_error("Runtime error: not a function.");
 
     if (lookUp == nullptr) return varData;
    
     else {
-      Array tempArray = std::get<Array>(varData);
-
-      if (!(std::holds_alternative<double>(lookUp->getValue(variables)))) throw std::runtime_error("Runtime error: index is not a number.");
+      List* tempArray = varData.array();
+      Value index = lookUp->getValue(variables);
 
-      double arrayIndex = std::get<double>(lookUp->getValue(variables));
-
-      if (std::fmod(arrayIndex, 1) != 0) throw std::runtime_error("Runtime error: index is not an integer.");
-      if (arrayIndex >= tempArray->size() || arrayIndex < 0) throw std::runtime_error("Runtime error: index out of bounds.");
-
-      return (*tempArray)[arrayIndex];
+      return tempArray->get(tempArray->index(index));
     }
   }
 
   // function case
-  else if (std::holds_alternative<Func>(varData)) {
+  else if (varData.isFunction()) {
     if (lookUp != nullptr) throw std::runtime_error("Runtime error: not an array.");
 
-    if (noArgs) return std::get<Func>(varData)->getValue({});
+    if (noArgs) return varData.function()->call(0);
 
     else if (arguments.size() == 0) return varData;
 
     else {
-      std::vector<Value> tempArgs;
+      // the arguments go straight into the callee's frame
+      std::vector<Value>& stack = valueStack();
 
       for (Node* node : arguments) {
-        tempArgs.push_back(node->getValue(variables));
+        Value argument = node->getValue(variables);
+        stack.push_back(std::move(argument));
       }
 
-      return std::get<Func>(varData)->getValue(tempArgs);
+      return varData.function()->call(arguments.size());
     }
   }
 
@@ -644,7 +706,7 @@ std::string VarNode::toString() {
   return result.str();
 }
 
-Value BoolNode::getValue([[maybe_unused]] std::map<std::string, Value>& variables) {
+Value BoolNode::getValue([[maybe_unused]] Env& variables) {
   if (lookUp != nullptr) throw std::runtime_error("Runtime error: not an array.");
 
   return value;
@@ -653,7 +715,7 @@ Value BoolNode::getValue([[maybe_unused]] std::map<std::string, Value>& variable
 std::string BoolNode::toString() {
   std::ostringstream result;
 
-  if (std::get<bool>(value)) result << "true";
+  if (value.boolean()) result << "true";
   else result << "false";
 
   if (lookUp != nullptr) result << "[" << lookUp->toString() << "]";
@@ -669,23 +731,25 @@ ArrayNode::~ArrayNode() {
   }
 }
 
-Value ArrayNode::getValue([[maybe_unused]] std::map<std::string, Value>& variables) {
+Value ArrayNode::getValue([[maybe_unused]] Env& variables) {
   Value result;
 
   // no array look up
   if (lookUp == nullptr) {
-    result = std::make_shared<std::vector<Value>>();
+    result = makeRef<List>();
 
     for (Node* node : value) {
-      std::get<Array>(result)->push_back(node->getValue(variables));
+      result.array()->push(node->getValue(variables));
     }
   }
 
   // array lookup
   else {
-    if (!(std::holds_alternative<double>(lookUp->getValue(variables)))) throw std::runtime_error("Runtime error: index is not a number.");
+    Value index = lookUp->getValue(variables);
+
+    if (!(index.isNumber())) throw std::runtime_error("Runtime error: index is not a number.");
 
-    double arrayIndex = std::get<double>(lookUp->getValue(variables));
+    double arrayIndex = index.number();
 
     if (std::fmod(arrayIndex, 1) != 0) throw std::runtime_error("Runtime error: index is not an integer.");
     if (arrayIndex >= value.size() || arrayIndex < 0) throw std::runtime_error("Runtime error: index out of bounds.");
@@ -713,7 +777,7 @@ std::string ArrayNode::toString() {
   return result.str();
 }
 
-Value NullNode::getValue([[maybe_unused]] std::map<std::string, Value>& variables) {
+Value NullNode::getValue([[maybe_unused]] Env& variables) {
   if (lookUp != nullptr) throw std::runtime_error("Runtime error: not an array.");
 
   return value;
@@ -728,30 +792,34 @@ OpNode::~OpNode() {
   delete rhs;
 }
 
-Value OpNode::getValue([[maybe_unused]] std::map<std::string, Value>& variables) {
-  if (!(std::holds_alternative<double>(lhs->getValue(variables)) && std::holds_alternative<double>(rhs->getValue(variables)))) {
-    std::ostringstream error;
-    error << "Runtime error: invalid operand type.";
-    throw std::runtime_error(error.str());
-  }
+// each operand is evaluated once, and the right one only after the left one turned out to be a number
+Value OpNode::getValue([[maybe_unused]] Env& variables) {
+  Value left = lhs->getValue(variables);
+  if (!(left.isNumber())) throw std::runtime_error("Runtime error: invalid operand type.");
+
+  Value right = rhs->getValue(variables);
+  if (!(right.isNumber())) throw std::runtime_error("Runtime error: invalid operand type.");
 
-  if (value == "+") return std::get<double>(lhs->getValue(variables)) + std::get<double>(rhs->getValue(variables));
+  double l = left.number();
+  double r = right.number();
 
-  else if (value == "-") return std::get<double>(lhs->getValue(variables)) - std::get<double>(rhs->getValue(variables));
+  if (op == OP_ADD) return l + r;
 
-  else if (value == "*") return std::get<double>(lhs->getValue(variables)) * std::get<double>(rhs->getValue(variables));
+  else if (op == OP_SUB) return l - r;
 
-  else if (value == "/") {
-    if (std::get<double>(rhs->getValue(variables)) == 0) {
+  else if (op == OP_MUL) return l * r;
+
+  else if (op == OP_DIV) {
+    if (r == 0) {
       std::ostringstream error;
-        error << "Runtime error: division by zero.";
-        throw std::runtime_error(error.str());
-      }
+      error << "Runtime error: division by zero.";
+      throw std::runtime_error(error.str());
+    }
 
-    return std::get<double>(lhs->getValue(variables)) / std::get<double>(rhs->getValue(variables));
+    return l / r;
   }
 
-  else if (value == "%") return std::fmod(std::get<double>(lhs->getValue(variables)), std::get<double>(rhs->getValue(variables)));
+  else if (op == OP_MOD) return std::fmod(l, r);
 
   else {
     std::cout << "This error should never happen. 3" << std::endl;
@@ -765,7 +833,9 @@ std::string OpNode::toString() {
   return result.str();
 }
 
-Value AssignNode::getValue([[maybe_unused]] std::map<std::string, Value>& variables) {
+// evaluates the right hand side once and only stores it if that succeeded
+// so an error anywhere on the right leaves the variable as it was
+Value AssignNode::getValue([[maybe_unused]] Env& variables) {
   if (!(lhs->isVar)) {
     if (lhs->lookUp != nullptr) {
       lhs->getValue(variables);
@@ -777,29 +847,58 @@ Value AssignNode::getValue([[maybe_unused]] std::map<std::string, Value>& variab
     throw std::runtime_error(error.str());
   }
 
-  rhs->getValue(variables);
+  VarNode* key = (VarNode*) lhs;
 
-  return lhs->getValue(variables);
-}
+  // a call on the left is not stored to
+  if (key->arguments.size() != 0 || key->noArgs) {
+    rhs->getValue(variables);
+    return lhs->getValue(variables);
+  }
 
-Value CompareNode::getValue([[maybe_unused]] std::map<std::string, Value>& variables) {
-  if (value == "==") return lhs->getValue(variables) == rhs->getValue(variables);
+  // element assignment only changes a specific index of an existing array
+  if (key->lookUp != nullptr) {
+    const Value* found = variables.find(key->symbol);
+    if (found == nullptr || !(found->isArray())) throw std::runtime_error("Runtime error: not an array.");
 
-  if (value == "!=") return lhs->getValue(variables) != rhs->getValue(variables);
+    // held, the index or the new value can assign the variable something else
+    Array tempArray(found->array());
+    Value index = key->lookUp->getValue(variables);
+    size_t arrayIndex = tempArray->index(index);
 
-  if (!(std::holds_alternative<double>(lhs->getValue(variables)) && std::holds_alternative<double>(rhs->getValue(variables)))) {
-    std::ostringstream error;
-    error << "Runtime error: invalid operand type.";
-    throw std::runtime_error(error.str());
+    Value data = rhs->getValue(variables);
+    tempArray->set(arrayIndex, data);
+    return data;
+  }
+
+  Value data = rhs->getValue(variables);
+  variables[key->symbol] = data;
+  return data;
+}
+
+// == and != run their right side first, like they always have
+Value CompareNode::getValue([[maybe_unused]] Env& variables) {
+  if (op == OP_EQ || op == OP_NE) {
+    Value right = rhs->getValue(variables);
+    bool equal = lhs->getValue(variables) == right;
+    return op == OP_EQ ? equal : !equal;
   }
 
-  if (value == "<") return std::get<double>(lhs->getValue(variables)) < std::get<double>(rhs->getValue(variables));
+  Value left = lhs->getValue(variables);
+  if (!(left.isNumber())) throw std::runtime_error("Runtime error: invalid operand type.");
 
-  else if (value == ">") return std::get<double>(lhs->getValue(variables)) > std::get<double>(rhs->getValue(variables));
+  Value right = rhs->getValue(variables);
+  if (!(right.isNumber())) throw std::runtime_error("Runtime error: invalid operand type.");
 
-  else if (value == "<=") return std::get<double>(lhs->getValue(variables)) <= std::get<double>(rhs->getValue(variables));
+  double l = left.number();
+  double r = right.number();
 
-  else if (value == ">=") return std::get<double>(lhs->getValue(variables)) >= std::get<double>(rhs->getValue(variables));
+  if (op == OP_LT) return l < r;
+
+  else if (op == OP_GT) return l > r;
+
+  else if (op == OP_LE) return l <= r;
+
+  else if (op == OP_GE) return l >= r;
 
   else {
     std::cout << "This error should never happen. 1" << std::endl;
@@ -807,18 +906,24 @@ Value CompareNode::getValue([[maybe_unused]] std::map<std::string, Value>& varia
   }
 }
 
-Value LogicNode::getValue([[maybe_unused]] std::map<std::string, Value>& variables) {
-  if (!(std::holds_alternative<bool>(lhs->getValue(variables)) && std::holds_alternative<bool>(rhs->getValue(variables)))) {
-    std::ostringstream error;
-    error << "Runtime error: invalid operand type.";
-    throw std::runtime_error(error.str());
-  }
+// & and | skip their right side when the left one already decides the result
+Value LogicNode::getValue([[maybe_unused]] Env& variables) {
+  Value left = lhs->getValue(variables);
+  if (!(left.isBool())) throw std::runtime_error("Runtime error: invalid operand type.");
+
+  bool l = left.boolean();
+
+  if (op == OP_AND && !l) return false;
+  if (op == OP_OR && l) return true;
+
+  Value right = rhs->getValue(variables);
+  if (!(right.isBool())) throw std::runtime_error("Runtime error: invalid operand type.");
 
-  if (value == "&") return std::get<bool>(lhs->getValue(variables)) && std::get<bool>(rhs->getValue(variables));
+  bool r = right.boolean();
 
-  else if (value == "|") return std::get<bool>(lhs->getValue(variables)) || std::get<bool>(rhs->getValue(variables));
+  if (op == OP_AND || op == OP_OR) return r;
 
-  else if (value == "^") return ((std::get<bool>(lhs->getValue(variables)) || std::get<bool>(rhs->getValue(variables))) && !(std::get<bool>(rhs->getValue(variables)) && std::get<bool>(rhs->getValue(variables))));
+  else if (op == OP_XOR) return (l || r) && !(r && r);
 
   else {
     std::cout << "This error should never happen. 2" << std::endl;
@@ -7,6 +7,7 @@
 #include <map>
 #include "token.h"
 #include "value.h"
+#include "flat.h"
 
 struct Node {
   Value value;
@@ -15,28 +16,29 @@ struct Node {
   Node* lookUp = nullptr;
 
   virtual ~Node();
-  virtual Value getValue([[maybe_unused]] std::map<std::string, Value>& variables) = 0;
+  virtual Value getValue([[maybe_unused]] Env& variables) = 0;
   virtual std::string toString() = 0;
 };
 
 struct NumNode : public Node {
-  Value getValue([[maybe_unused]] std::map<std::string, Value>& variables);
+  Value getValue([[maybe_unused]] Env& variables);
   std::string toString();
 };
 
 struct VarNode : public Node {
   std::string value;
+  int symbol = NO_SYMBOL;
   std::vector<Node*> arguments;
   bool noArgs = false;
 
   ~VarNode();
   VarNode() {isVar = true;}
-  Value getValue([[maybe_unused]] std::map<std::string, Value>& variables);
+  Value getValue([[maybe_unused]] Env& variables);
   std::string toString();
 };
 
 struct BoolNode : public Node {
-  Value getValue([[maybe_unused]] std::map<std::string, Value>& variables);
+  Value getValue([[maybe_unused]] Env& variables);
   std::string toString();
 };
 
@@ -44,60 +46,76 @@ struct ArrayNode : public Node {
   std::vector<Node*> value;
 
   ~ArrayNode();
-  Value getValue([[maybe_unused]] std::map<std::string, Value>& variables);
+  Value getValue([[maybe_unused]] Env& variables);
   std::string toString();
 };
 
 struct NullNode : public Node {
-  Value getValue([[maybe_unused]] std::map<std::string, Value>& variables);
+  Value getValue([[maybe_unused]] Env& variables);
   std::string toString();
 };
 
 struct OpNode : public Node {
   std::string value;
+  Op op = OP_NONE;
   Node* lhs;
   Node* rhs;
 
   ~OpNode();
-  virtual Value getValue([[maybe_unused]] std::map<std::string, Value>& variables);
+  virtual Value getValue([[maybe_unused]] Env& variables);
   std::string toString();
 };
 
 struct AssignNode : public OpNode {
-  Value getValue([[maybe_unused]] std::map<std::string, Value>& variables);
+  Value getValue([[maybe_unused]] Env& variables);
 };
 
 struct CompareNode : public OpNode {
-  Value getValue([[maybe_unused]] std::map<std::string, Value>& variables);
+  Value getValue([[maybe_unused]] Env& variables);
 };
 
 struct LogicNode : public OpNode {
-  Value getValue([[maybe_unused]] std::map<std::string, Value>& variables);
+  Value getValue([[maybe_unused]] Env& variables);
 };
 
+// built in functions
+Value len(Value value);
+Value pop(Value value);
+Value push(Value value, Value element);
+
 //______________________________________________________________________________
 
+// the tree is kept for toString, calculate runs the flat copy of it
 class InfixParser {
-  Node* root;
+  // owned from the moment parse builds it, so an error found after that does not leak it
+  std::unique_ptr<Node> root;
+  FlatExpr flat;
   int index = -1;
   size_t parenNum = 0;
   //size_t bracketNum = 0;
-  bool updateVariables = true;
-  std::vector<std::pair<Node*, Node*>> variableBuffer;
-  std::map<std::string, Value>& varCache;
 
-  Node* createTree(Node* leftHandSide, int minPrecedence, std::vector<Token> tokens);
-  int precedence(std::string op);
-  Token& peak(std::vector<Token> tokens);
-  Node* nextNode(std::vector<Token> tokens);
-  Value stringToValue(Token& token);
+  // the expression and the END token that follows it, at() hands out END past the last token
+  // only used while parsing, the tree keeps its own copies
+  TokenSpan tokens;
+  Token endToken{0, 0, "END", END};
+  size_t length;
 
-public:
-  InfixParser(std::vector<Token> tokens, std::map<std::string, Value>& variables);
-  ~InfixParser();
+  const Token& at(size_t i) const;
+  void parse();
+  Node* parseExpression();
+  int precedence(const Token& op) const;
+  const Token& peak();
+  Value stringToValue(const Token& token);
 
-  std::string toString();
-  Value calculate();
+public:
+  InfixParser(TokenSpan tokens);
+  InfixParser(TokenSpan tokens, Token end);
+  InfixParser(const InfixParser&) = delete;
+
+  std::string toString() const;
+  Value calculate(Env& variables) const;
+  void assigned(std::vector<int>& symbols) const;
+  const FlatExpr& code() const {return flat;}
 };
 
 #endif
@@ -5,374 +5,651 @@
 #include "lexer.h"
 #include <sstream>
 #include <stdexcept>
+#include <memory>
+#include <cerrno>
+#include <cstring>
+#include <algorithm>
+#include <charconv>
+#include <limits>
+#include <exception>
+#include <thread>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#include <immintrin.h>
+#define LEXER_SIMD 1
+#endif
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#define LEXER_POSIX 1
+#endif
+
+namespace {
+    const size_t CHUNK_SIZE = 1 << 16;
+
+    // Smallest piece of a file worth handing to its own thread
+    const size_t PARALLEL_CHUNK = 1 << 20;
+
+    // Reads everything left on a stream with large block reads instead of get() per character
+    std::string readChunked(std::istream& stream){
+        std::string raw;
+        std::unique_ptr<char[]> chunk(new char[CHUNK_SIZE]);
+
+        while(stream.read(chunk.get(), CHUNK_SIZE) || stream.gcount() > 0){
+            raw.append(chunk.get(), (size_t)stream.gcount());
+        }
 
+        return raw;
+    }
 
-void Lexer::pushSeq(std::string element, TokenType type, int line, int column, std::vector<Token> &sequence){
-    if(element != ""){
-        if(type==NUMBER){
-            if(element[0]=='.'){
-                std::ostringstream error;
-                error << "Syntax error on line "<< line <<" column "<< int(column)<<".";
-                throw std::runtime_error(error.str());
-            }
-            if(element.back() == '.'){
-                std::ostringstream error;
-                error << "Syntax error on line "<< line <<" column "<< (int)(column + element.size()) <<".";
-                throw std::runtime_error(error.str());
+    // Run scanners: each returns the first character at or after p that ends the run
+    // Whitespace also counts the newlines it skips so line and column reporting stays exact
+    const char* spanDigitsScalar(const char* p, const char* end){
+        while (p < end && Token::tokenType(*p) == NUMBER) p++;
+        return p;
+    }
+
+    const char* spanWordScalar(const char* p, const char* end){
+        while (p < end && (Token::tokenType(*p) == VARIABLE || (*p >= '0' && *p <= '9'))) p++;
+        return p;
+    }
+
+    const char* skipSpaceScalar(const char* p, const char* end, int& line, const char*& lineStart){
+        while (p < end && Token::tokenType(*p) == SPACE) {
+            if(*p == '\n'){
+                line++;
+                lineStart = p + 1;
             }
+            p++;
         }
+        return p;
+    }
 
-        if(element == "else "){
-            element = "else";
-        }
+#ifdef LEXER_SIMD
+    // lo <= x <= hi for every byte, done as one signed compare after shifting lo down to -128
+    #define BYTE_RANGE(mm, x, lo, hi) mm##_cmpgt_epi8(mm##_set1_epi8((char)(0x80 + (hi) - (lo) + 1)), mm##_add_epi8(x, mm##_set1_epi8((char)(0x80 - (lo)))))
+
+    // Byte masks of the three classes, a byte is all ones when it belongs to the run
+    #define DIGIT_MASK(mm, bits, x) mm##_or_si##bits(BYTE_RANGE(mm, x, '0', '9'), mm##_cmpeq_epi8(x, mm##_set1_epi8('.')))
+    #define WORD_MASK(mm, bits, x) mm##_or_si##bits(mm##_or_si##bits(BYTE_RANGE(mm, mm##_or_si##bits(x, mm##_set1_epi8(0x20)), 'a', 'z'), BYTE_RANGE(mm, x, '0', '9')), mm##_cmpeq_epi8(x, mm##_set1_epi8('_')))
+    #define SPACE_MASK(mm, bits, x) mm##_or_si##bits(BYTE_RANGE(mm, x, '\t', '\r'), mm##_cmpeq_epi8(x, mm##_set1_epi8(' ')))
+
+    // Generates the 16 byte (SSE2) and 32 byte (AVX2) versions of the scanners, falling back to scalar for the tail
+    #define RUN_SCANNERS(suffix, isa, mm, bits, lanes, vector, full)                                                      \
+    __attribute__((target(isa))) const char* spanDigits##suffix(const char* p, const char* end){                          \
+        while (end - p >= lanes) {                                                                                        \
+            vector x = mm##_loadu_si##bits((const vector*)p);                                                             \
+            unsigned run = (unsigned)mm##_movemask_epi8(DIGIT_MASK(mm, bits, x));                                         \
+            if(run != full) return p + __builtin_ctz(~run);                                                               \
+            p += lanes;                                                                                                   \
+        }                                                                                                                 \
+        return spanDigitsScalar(p, end);                                                                                  \
+    }                                                                                                                     \
+                                                                                                                          \
+    __attribute__((target(isa))) const char* spanWord##suffix(const char* p, const char* end){                            \
+        while (end - p >= lanes) {                                                                                        \
+            vector x = mm##_loadu_si##bits((const vector*)p);                                                             \
+            unsigned run = (unsigned)mm##_movemask_epi8(WORD_MASK(mm, bits, x));                                          \
+            if(run != full) return p + __builtin_ctz(~run);                                                               \
+            p += lanes;                                                                                                   \
+        }                                                                                                                 \
+        return spanWordScalar(p, end);                                                                                    \
+    }                                                                                                                     \
+                                                                                                                          \
+    __attribute__((target(isa))) const char* skipSpace##suffix(const char* p, const char* end, int& line, const char*& lineStart){ \
+        while (end - p >= lanes) {                                                                                        \
+            vector x = mm##_loadu_si##bits((const vector*)p);                                                             \
+            unsigned run = (unsigned)mm##_movemask_epi8(SPACE_MASK(mm, bits, x));                                         \
+            unsigned newlines = (unsigned)mm##_movemask_epi8(mm##_cmpeq_epi8(x, mm##_set1_epi8('\n')));                   \
+            int length = run == full ? lanes : __builtin_ctz(~run);                                                       \
+            if(length < lanes) newlines &= (1u << length) - 1;                                                            \
+            if(newlines != 0){                                                                                            \
+                line += __builtin_popcount(newlines);                                                                     \
+                lineStart = p + (31 - __builtin_clz(newlines)) + 1;                                                       \
+            }                                                                                                             \
+            if(length < lanes) return p + length;                                                                         \
+            p += lanes;                                                                                                   \
+        }                                                                                                                 \
+        return skipSpaceScalar(p, end, line, lineStart);                                                                  \
+    }
 
-        if(element == "while" || element == "if" || element == "print" || element == "else" || element == "else if"){
-            sequence.push_back(Token{line,column, element, COMMAND});
-        } else if(element == "true" || element == "false"){
-            sequence.push_back(Token{line,column, element, BOOL});
-        } else if(element == "<=" || element == ">=" || element == "==" || element == ">" || element == "<" || element == "!="){
-            sequence.push_back(Token{line,column, element, COMPARE});
-        } else if(element == "def"){
-            sequence.push_back(Token{line,column, element, FUNCTION});
-        } else if(element == "return"){
-            sequence.push_back(Token{line,column, element, RETURN});
-        } else if(element == "null"){
-            sequence.push_back(Token{line,column, element, NILL});
-        }else {
-            sequence.push_back(Token{line,column, element, type});
+    RUN_SCANNERS(SSE2, "sse2", _mm, 128, 16, __m128i, 0xFFFFu)
+    RUN_SCANNERS(AVX2, "avx2", _mm256, 256, 32, __m256i, 0xFFFFFFFFu)
+#endif
+
+    // The scanners for this CPU, picked once at startup
+    struct RunScanners {
+        const char* (*spanDigits)(const char*, const char*) = spanDigitsScalar;
+        const char* (*spanWord)(const char*, const char*) = spanWordScalar;
+        const char* (*skipSpace)(const char*, const char*, int&, const char*&) = skipSpaceScalar;
+
+        RunScanners(){
+#ifdef LEXER_SIMD
+            __builtin_cpu_init();
+            if(__builtin_cpu_supports("avx2")){
+                spanDigits = spanDigitsAVX2;
+                spanWord = spanWordAVX2;
+                skipSpace = skipSpaceAVX2;
+            } else if(__builtin_cpu_supports("sse2")){
+                spanDigits = spanDigitsSSE2;
+                spanWord = spanWordSSE2;
+                skipSpace = skipSpaceSSE2;
+            }
+#endif
         }
+    };
+
+    const RunScanners SCANNERS;
+
+#ifdef LEXER_POSIX
+    // Maps a regular file read-only, the mapping is released with the last copy of the pointer
+    // returns nullptr if the descriptor can't be mapped (pipes, terminals, empty files)
+    std::shared_ptr<const char> mapFile(int fd, size_t& size){
+        struct stat info;
+        if(fstat(fd, &info) != 0 || !S_ISREG(info.st_mode) || info.st_size == 0) return nullptr;
+
+        size_t length = (size_t)info.st_size;
+        void* mapped = mmap(nullptr, length, PROT_READ, MAP_PRIVATE, fd, 0);
+        if(mapped == MAP_FAILED) return nullptr;
+
+        madvise(mapped, length, MADV_SEQUENTIAL);
+        size = length;
+        return std::shared_ptr<const char>((const char*)mapped, [length](const char* data){ munmap((void*)data, length); });
     }
+#endif
 }
 
+void Lexer::syntaxError(int line, int column){
+    std::ostringstream error;
+    error << "Syntax error on line "<< line <<" column "<< column <<".";
+    throw std::runtime_error(error.str());
+}
 
-std::vector<Token> Lexer::lexer(){
-    std::vector<Token> sequence;
-    char rawInput;
-    int line = 1;
-    int i = 1;
-    int indents = 0;
-
-    //This will later be used to check for more than one decimal in number
-    int numDecimal = 0;
-    std::string element = "";
-    while (std::cin.get(rawInput)) {
-        if(rawInput == '\n'){
-            indents++;
-
-            //When you start a newline, take what was inside element and add it to sequence, this will always be a number or var
-            if(Token::tokenType(element[0]) != NULLTYPE){ 
-                pushSeq(element, Token::tokenType(element[0]), line, i - element.size(), sequence);
+// The lexing engine shared by every entry point, a DFA over a contiguous buffer
+// Each state is entered from the class of the first character (see CHAR_CLASSES in token.h)
+// Appends the tokens of data (which starts on the given line) and returns the line it ends on
+int Lexer::scan(const char* data, size_t size, int line, std::vector<Token>& sequence){
+    const char* end = data + size;
+    const char* lineStart = data;
+
+    const char* p = data;
+    while (p < end) {
+        TokenType type = Token::tokenType(*p);
+        int column = (int)(p - lineStart) + 1;
+
+        switch (type) {
+            case SPACE: {
+                p = SCANNERS.skipSpace(p, end, line, lineStart);
+                break;
             }
 
+            case NUMBER: {
+                //Digits and decimals, a letter straight after a number or a second decimal is an error
+                const char* start = p;
+                p = SCANNERS.spanDigits(p, end);
 
-            i=0;
-            line++;
-            element="";
-        } else {
-            indents = 0;
-        }
+                const char* decimal = (const char*)std::memchr(start, '.', p - start);
+                if(decimal != nullptr){
+                    const char* second = (const char*)std::memchr(decimal + 1, '.', p - decimal - 1);
+                    if(second != nullptr) syntaxError(line, (int)(second - lineStart) + 1);
+                }
+                if(p < end && Token::tokenType(*p) == VARIABLE) syntaxError(line, (int)(p - lineStart) + 1);
 
-        TokenType type = Token::tokenType(rawInput);
+                if(*start == '.') syntaxError(line, column);
+                if(*(p - 1) == '.') syntaxError(line, column + (int)(p - start));
 
-        //Decimal error (two decimals in the same num)
-        if((numDecimal > 0 && rawInput == '.') || type == NULLTYPE){
-            std::ostringstream error;
-            error << "Syntax error on line "<< line <<" column "<< i<<".";
-            throw std::runtime_error(error.str());
-        }
-
-       
-
-        if(type != SPACE){
-                if(Token::tokenType(rawInput)==NUMBER) {
-                    if(Token::tokenType(element[0]) == NUMBER || element == ""){
-                        if(rawInput == '.'){
-                            numDecimal++;
-                        }
-                        element += rawInput;
-                    } else if (Token::tokenType(element[0]) == VARIABLE){
-                        if(rawInput == '.'){
-                            std::ostringstream error;
-                            error << "Syntax error on line "<< line <<" column "<< i<<".";
-                            throw std::runtime_error(error.str());
-                        }
-
-                        element += rawInput;
-                    } else {
-                         //When the number input stops, insert it and then insert what you land on
-                        pushSeq(element, Token::tokenType(element[0]), line, i - element.size(), sequence);
-                        numDecimal = 0;
-                        std::string rawInputString(1, rawInput);
-                        pushSeq(rawInputString, type, line, i, sequence);
-                        element = "";
-                    }
-                    
-                } else if(Token::tokenType(rawInput) == VARIABLE){
-                    if(Token::tokenType(element[0]) == NUMBER){
-                        std::ostringstream error;
-                        error << "Syntax error on line "<< line <<" column "<< i<<".";
-                        throw std::runtime_error(error.str());
-                    } else if (Token::tokenType(element[0]) == VARIABLE || element == ""){
-                        element += rawInput;
-                    } else {
-                        //When the variable input stops, insert it and then insert what you land on
-                        if(element == "else " && rawInput == 'i'){
-                            element = "else i";
-                        }
-
-                        else if (element == "else f" && rawInput == 'f'){
-                            pushSeq("else if", COMMAND, line, i - element.size(), sequence);
-                            numDecimal = 0;
-                            element = "";
-                        }
-
-                        else {
-                            pushSeq(element, Token::tokenType(element[0]), line, i - element.size(), sequence);
-                            numDecimal = 0;
-                            std::string rawInputString(1, rawInput);
-                            pushSeq(rawInputString, type, line, i, sequence);
-                            element = "";
-                        } 
-                        
+                double number = 0;
+                //too many digits for a double, like strtod a literal of 1 or more becomes inf and a smaller one 0
+                if(std::from_chars(start, p, number).ec == std::errc::result_out_of_range){
+                    const char* whole = decimal != nullptr ? decimal : p;
+                    bool large = std::find_if(start, whole, [](char digit){ return digit != '0'; }) != whole;
+                    number = large ? std::numeric_limits<double>::infinity() : 0;
+                }
+                sequence.push_back(Token{line, column, std::string_view(start, p - start), NUMBER, NO_SYMBOL, number});
+                break;
+            }
 
+            case VARIABLE: {
+                //Identifiers and keywords, digits are allowed after the first character
+                const char* start = p;
+                p = SCANNERS.spanWord(p, end);
+                if(p < end && *p == '.') syntaxError(line, (int)(p - lineStart) + 1);
+
+                std::string_view text(start, p - start);
+                int symbol = NO_SYMBOL;
+                TokenType word = Token::keywordType(start, p - start, symbol);
+                if(word == VARIABLE){
+                    sequence.push_back(Token{line, column, text, VARIABLE, Symbols::intern(text)});
+                    break;
+                }
 
-                    }
+                //"else if" is a single command as long as both words are on the same line
+                if(p - start == 4 && *start == 'e'){
+                    const char* look = p;
+                    while (look < end && *look != '\n' && Token::tokenType(*look) == SPACE) look++;
 
-                } else {
-                    //Check for 2 char conditionsals
-                    if(Token::tokenType(element[0])!=LOGIC && Token::tokenType(element[0])!=COMPARE && element[0] != '=' && rawInput != '='){
-                        pushSeq(element, Token::tokenType(element[0]), line, i - element.size(), sequence);
-                        numDecimal = 0;
-                        element="";
+                    if(look + 1 < end && look[0] == 'i' && look[1] == 'f' && (look + 2 == end || (Token::tokenType(look[2]) != VARIABLE && Token::tokenType(look[2]) != NUMBER))){
+                        sequence.push_back(Token{line, column, "else if", COMMAND, SYM_ELSE_IF});
+                        p = look + 2;
+                        break;
                     }
+                }
 
-                    if(element == "=" && rawInput != '='){
-                        pushSeq("=", ASSIGNMENT, line, i-1, sequence);
-                        element = rawInput;
-                    }
+                sequence.push_back(Token{line, column, text, word, symbol});
+                break;
+            }
 
-                    else if((element == "<" || element == "=" || element == ">" || element == "!") && rawInput == '='){
-                        pushSeq(element+rawInput, COMPARE, line, i-1, sequence);
-                        element = "";
-                    }
+            case COMPARE:
+            case ASSIGNMENT: {
+                //Two character comparisons (<=, >=, ==, !=)
+                size_t width = p + 1 < end && p[1] == '=' ? 2 : 1;
+                std::string_view text(p, width);
+                sequence.push_back(Token{line, column, text, width == 2 ? COMPARE : type, NO_SYMBOL, 0, 0, Token::opOf(text)});
+                p += width;
+                break;
+            }
 
-                    else if((element == "<" || element == ">" || element == "!") && rawInput != '='){
-                        pushSeq(element, COMPARE, line, i-1, sequence);
-                        element = rawInput;
-                    } 
+            case NULLTYPE: {
+                syntaxError(line, column);
+                break;
+            }
 
-                    else if(Token::tokenType(rawInput)==COMPARE || rawInput == '='){
-                        pushSeq(element, Token::tokenType(element[0]), line, i-element.size(), sequence);
-                        element = rawInput;
-                    }
-                    
-                    else {
-                        std::string rawInputString(1, rawInput);
-                        pushSeq(rawInputString, type, line, i, sequence);
-                        element = "";
-                    }
-                }
-                
-        } else {
-             if(element == "else if" || element.substr(0, 4) != "else"){
-                pushSeq(element, Token::tokenType(element[0]), line, i - element.size(), sequence);
-                element = "";
-                numDecimal = 0;
-             } else {
-                element += " ";
-             }
+            default: {
+                //Every other character is a token on its own
+                std::string_view text(p, 1);
+                sequence.push_back(Token{line, column, text, type, NO_SYMBOL, 0, 0, Token::opOf(text)});
+                p++;
+                break;
+            }
         }
-
-        i++;
     }
 
-    //After termination, add whatever was stored in element to the sequence
-    if(element != ""){
-        pushSeq(element, Token::tokenType(element[0]), line, i - element.size(), sequence);
-    }
+    return line;
+}
+
+// Lexes a whole buffer and terminates it with END
+// fromStream decides where END goes: scripts put it on the next line after a trailing newline,
+// single expressions (calc) put it one past the last column
+std::vector<Token> Lexer::lexBuffer(const char* data, size_t size, bool fromStream){
+    std::vector<Token> sequence;
+    int line = fromStream ? scanParallel(data, size, sequence) : scan(data, size, 1, sequence);
 
     //Insert END (either new line or same line)
-    if(sequence.size() == 0 || indents >= 1){
+    if(!fromStream){
+        sequence.push_back(Token{line,(int)size+1,"END", END});
+    } else if(sequence.size() == 0 || data[size - 1] == '\n'){
         sequence.push_back(Token{line,1,"END", END});
     } else {
         sequence.push_back(Token{line,sequence.back().column+1,"END", END});
     }
 
+    matchBrackets(sequence);
     return sequence;
 }
 
 
 
-void Lexer::pushSeqThrow(std::string element, TokenType type, int line, int column, std::vector<Token> &sequence){
-    if(element != ""){
-        if(type==NUMBER){
-            if(element[0]=='.'){
-                std::ostringstream error;
-                error << "Syntax error on line "<< line <<" column "<< int(column)<<".";
-                throw std::runtime_error(error.str());
-            }
-            if(element.back() == '.'){
-                std::ostringstream error;
-                error << "Syntax error on line "<< line <<" column "<< (int)(column + element.size()) <<".";
-                throw std::runtime_error(error.str());
-            }
-        }
+//Links every (, [ and { to its partner in one pass so blocks and argument lists can be skipped in O(1)
+//Each kind is matched on its own, the same way the parser counts them
+void Lexer::matchBrackets(std::vector<Token>& tokens){
+    std::vector<size_t> open[3];
 
+    for(size_t i = 0; i < tokens.size(); i++){
+        Token& token = tokens[i];
+        if(token.type != PARENTHESIS && token.type != BRACKET && token.type != BLOCK) continue;
 
-        if(element == "else "){
-            element = "else";
-        }
+        int kind = token.type == PARENTHESIS ? 0 : token.type == BRACKET ? 1 : 2;
+        token.match = 0;
 
+        if(token.token == "(" || token.token == "[" || token.token == "{"){
+            open[kind].push_back(i);
+        } else if(!open[kind].empty()){
+            Token& partner = tokens[open[kind].back()];
+            open[kind].pop_back();
 
-        if(element == "while" || element == "if" || element == "print" || element == "else" || element == "else if"){
-            sequence.push_back(Token{line,column, element, COMMAND});
-        } else if(element == "true" || element == "false"){
-            sequence.push_back(Token{line,column, element, BOOL});
-        } else if(element == "<=" || element == ">=" || element == "==" || element == ">" || element == "<" || element == "!="){
-            sequence.push_back(Token{line,column, element, COMPARE});
-        } else if(element == "def"){
-            sequence.push_back(Token{line,column, element, FUNCTION});
-        } else if(element == "return"){
-            sequence.push_back(Token{line,column, element, RETURN});
-        } else if(element == "null"){
-            sequence.push_back(Token{line,column, element, NILL});
-        } else {
-            sequence.push_back(Token{line,column, element, type});
+            partner.match = (int)(&token - &partner);
+            token.match = -partner.match;
         }
     }
 }
 
+//Splits a large buffer just after newlines and scans the pieces on their own threads
+//Nothing the lexer tracks carries over a newline (else if has to be on one line), so the pieces are independent
+//Newlines are counted first so every piece knows its starting line, then the token vectors are joined in order
+//If several pieces have errors the first one is reported, the same one the serial scan would have stopped on
+int Lexer::scanParallel(const char* data, size_t size, std::vector<Token>& sequence){
+    size_t pieces = std::min((size_t)threads, size / PARALLEL_CHUNK);
+    if(pieces < 2){
+        return scan(data, size, 1, sequence);
+    }
+
+    std::vector<const char*> bounds{data};
+    for(size_t i = 1; i < pieces; i++){
+        const char* cut = std::max(bounds.back(), data + size * i / pieces);
+        const char* newline = (const char*)std::memchr(cut, '\n', data + size - cut);
+        if(newline == nullptr) break;
+        bounds.push_back(newline + 1);
+    }
+    bounds.push_back(data + size);
+    pieces = bounds.size() - 1;
+
+    std::vector<int> lines(pieces + 1, 1);
+    std::vector<std::vector<Token>> results(pieces);
+    std::vector<std::exception_ptr> errors(pieces);
+    std::vector<std::thread> workers;
+
+    for(size_t i = 0; i < pieces; i++){
+        workers.emplace_back([&, i](){
+            lines[i + 1] = (int)std::count(bounds[i], bounds[i + 1], '\n');
+        });
+    }
+    for(std::thread& worker : workers) worker.join();
+    workers.clear();
+
+    for(size_t i = 0; i < pieces; i++){
+        lines[i + 1] += lines[i];
+    }
+
+    for(size_t i = 0; i < pieces; i++){
+        workers.emplace_back([&, i](){
+            try {
+                results[i].reserve((bounds[i + 1] - bounds[i]) / 4);
+                scan(bounds[i], bounds[i + 1] - bounds[i], lines[i], results[i]);
+            } catch (...) {
+                errors[i] = std::current_exception();
+            }
+        });
+    }
+    for(std::thread& worker : workers) worker.join();
+
+    size_t total = 0;
+    for(size_t i = 0; i < pieces; i++){
+        if(errors[i] != nullptr) std::rethrow_exception(errors[i]);
+        total += results[i].size();
+    }
+
+    sequence.reserve(total + 1);
+    for(const std::vector<Token>& result : results){
+        sequence.insert(sequence.end(), result.begin(), result.end());
+    }
+
+    return lines[pieces];
+}
+
+//Sets how many threads lexing a large file may use, 0 picks one per core
+void Lexer::setThreads(unsigned count){
+    threads = count != 0 ? count : std::max(1u, std::thread::hardware_concurrency());
+}
+
+//Keeps a copy of raw alive for as long as the lexer so tokens can point into it
+const char* Lexer::keep(std::string raw){
+    std::shared_ptr<std::string> owned = std::make_shared<std::string>(std::move(raw));
+    sources.push_back(std::shared_ptr<const char>(owned, owned->data()));
+    return sources.back().get();
+}
+
+//Reads the script from standard input
+std::vector<Token> Lexer::lexer(){
+#ifdef LEXER_POSIX
+    //Redirected files can be mapped directly, pipes and terminals fall back to chunked reads
+    size_t size = 0;
+    std::shared_ptr<const char> mapped = mapFile(STDIN_FILENO, size);
+    if(mapped != nullptr){
+        sources.push_back(mapped);
+        return lexBuffer(mapped.get(), size, true);
+    }
+#endif
+
+    std::string raw = readChunked(std::cin);
+    size_t length = raw.size();
+    return lexBuffer(keep(std::move(raw)), length, true);
+}
+
+//Reads the script from a file path
+std::vector<Token> Lexer::lexFile(const std::string& path){
+#ifdef LEXER_POSIX
+    int fd = open(path.c_str(), O_RDONLY);
+    if(fd < 0){
+        std::ostringstream error;
+        error << "Could not open file " << path << ".";
+        throw std::runtime_error(error.str());
+    }
+
+    size_t size = 0;
+    std::shared_ptr<const char> mapped = mapFile(fd, size);
+    close(fd);
+    if(mapped != nullptr){
+        sources.push_back(mapped);
+        return lexBuffer(mapped.get(), size, true);
+    }
+#endif
+
+    std::ifstream file(path, std::ios::binary);
+    if(!file){
+        std::ostringstream error;
+        error << "Could not open file " << path << ".";
+        throw std::runtime_error(error.str());
+    }
+
+    std::string raw = readChunked(file);
+    size_t length = raw.size();
+    return lexBuffer(keep(std::move(raw)), length, true);
+}
+
 //Used for the Infix parser
 std::vector<Token> Lexer::lexer(std::string raw){
-    std::vector<Token> sequence;
-    int line = 1;
-    int i = 1;
-    //This will later be used to check for more than one decimal in number
-    int numDecimal = 0;
-    std::string element = "";
-    char rawInput;
-    for(int r = 0; r <= (int)raw.length(); r++) {
-        if(r == (int)raw.length()){
-            if(Token::tokenType(element[0]) != NULLTYPE){ 
-                pushSeqThrow(element, Token::tokenType(element[0]), line, i - element.size(), sequence);
-            }
+    size_t length = raw.size();
+    return lexBuffer(keep(std::move(raw)), length, false);
+}
+
+//Streams stdin a statement at a time instead of reading it all up front, see nextStatement
+void Lexer::openStream(){
+#ifdef LEXER_POSIX
+    streamFd = STDIN_FILENO;
+    if(pipe(wakeFds) != 0) throw std::runtime_error("Could not read the input.");
+#else
+    streamInput = &std::cin;
+#endif
+}
+
+//Streams a script file a statement at a time
+void Lexer::openStream(const std::string& path){
+#ifdef LEXER_POSIX
+    streamFd = open(path.c_str(), O_RDONLY);
+    if(streamFd < 0){
+#else
+    streamFile.reset(new std::ifstream(path, std::ios::binary));
+    streamInput = streamFile.get();
+    if(!*streamFile){
+#endif
+        std::ostringstream error;
+        error << "Could not open file " << path << ".";
+        throw std::runtime_error(error.str());
+    }
+#ifdef LEXER_POSIX
+    if(pipe(wakeFds) != 0) throw std::runtime_error("Could not read the input.");
+#endif
+}
+
+Lexer::~Lexer(){
+#ifdef LEXER_POSIX
+    if(streamFd > STDIN_FILENO) close(streamFd);
+    for(int fd : wakeFds){
+        if(fd >= 0) close(fd);
+    }
+#endif
+}
 
-            break;
+//Without poll a read that is already waiting on a terminal still has to return first
+void Lexer::stopStream(){
+    streamStopped = true;
+#ifdef LEXER_POSIX
+    if(wakeFds[1] >= 0){
+        char wake = 0;
+        while(write(wakeFds[1], &wake, 1) < 0 && errno == EINTR){}
+    }
+#endif
+}
+
+//Appends whatever input is available to partial, returns false at the end of the input
+//read() hands back a line as soon as it is typed or piped instead of waiting for a full block
+bool Lexer::readMore(){
+    if(streamEof || streamStopped){
+        return false;
+    }
+
+#ifdef LEXER_POSIX
+    char chunk[CHUNK_SIZE];
+    while(true){
+        //waits for input or for stopStream, whichever comes first
+        pollfd waiting[2] = {{streamFd, POLLIN, 0}, {wakeFds[0], POLLIN, 0}};
+        if(poll(waiting, 2, -1) < 0 && errno == EINTR) continue;
+        if(waiting[1].revents != 0){
+            streamEof = true;
+            return false;
         }
-        
-        rawInput = raw.at(r);
-        TokenType type = Token::tokenType(rawInput);
 
-       
+        ssize_t count = read(streamFd, chunk, CHUNK_SIZE);
+        if(count > 0){
+            partial.append(chunk, (size_t)count);
+            return true;
+        }
+        if(count < 0 && errno == EINTR) continue;
+        streamEof = true;
+        return false;
+    }
+#else
+    std::string line;
+    if(!std::getline(*streamInput, line)){
+        streamEof = true;
+        return false;
+    }
+    partial += line;
+    if(!streamInput->eof()) partial += '\n';
+    return true;
+#endif
+}
+
+//Lexes the next line of streamed input, or END once the input runs out
+//returns false after END has been produced
+bool Lexer::readLine(SourceLine& line){
+    line.text = nullptr;
+    line.tokens.clear();
 
-        if(type == NULLTYPE || (numDecimal > 0 && rawInput == '.')){
-            std::ostringstream error;
-            error << "Syntax error on line "<< line <<" column "<< i <<".";
-            throw std::runtime_error(error.str());
+    if(streamEnded){
+        return false;
+    }
+
+    size_t newline;
+    while((newline = partial.find('\n', partialStart)) == std::string::npos){
+        if(partialStart > 0){
+            partial.erase(0, partialStart);
+            partialStart = 0;
         }
+        if(!readMore()) break;
+    }
 
-        if(type != SPACE){
-                if(Token::tokenType(rawInput)==NUMBER) {
-                    if(Token::tokenType(element[0]) == NUMBER || element == ""){
-                        if(rawInput == '.'){
-                            numDecimal++;
-                        }
-                        element += rawInput;
-                    } else if (Token::tokenType(element[0]) == VARIABLE){
-                        if(rawInput == '.'){
-                            std::ostringstream error;
-                            error << "Syntax error on line "<< line <<" column "<< i <<".";
-                            throw std::runtime_error(error.str());
-                        }
-                        element += rawInput;
-                    } else {
-                        pushSeqThrow(element, Token::tokenType(element[0]), line, i - element.size(), sequence);
-                        numDecimal = 0;
-                        std::string rawInputString(1, rawInput);
-                        pushSeqThrow(rawInputString, type, line, i, sequence);
-                        element = "";
-                    }
-                    
-                } else if(Token::tokenType(rawInput)==VARIABLE){
-                    if(Token::tokenType(element[0]) == NUMBER){
-                        std::ostringstream error;
-                        error << "Syntax error on line "<< line <<" column "<< i <<".";
-                        throw std::runtime_error(error.str());
-                    } else if (Token::tokenType(element[0]) == VARIABLE || element == ""){
-                        element += rawInput;
-                    } else {
-                          //When the variable input stops, insert it and then insert what you land on
-                        if(element == "else " && rawInput == 'i'){
-                            element = "else i";
-                        }
-
-                        else if (element == "else f" && rawInput == 'f'){
-                            pushSeq("else if", COMMAND, line, i - element.size(), sequence);
-                            numDecimal = 0;
-                            element = "";
-                        }
-
-                        else {
-                            pushSeq(element, Token::tokenType(element[0]), line, i - element.size(), sequence);
-                            numDecimal = 0;
-                            std::string rawInputString(1, rawInput);
-                            pushSeq(rawInputString, type, line, i, sequence);
-                            element = "";
-                        } 
-                        
-                    }
+    if(partialStart == partial.size()){
+        //Insert END (either new line or same line)
+        if(streamColumn == 0 || streamNewline){
+            line.tokens.push_back(Token{streamLine,1,"END", END});
+        } else {
+            line.tokens.push_back(Token{streamLine,streamColumn+1,"END", END});
+        }
+        streamEnded = true;
+        return true;
+    }
 
-                } else {
-                    if(Token::tokenType(element[0])!=LOGIC && Token::tokenType(element[0])!=COMPARE && element[0] != '=' && rawInput != '='){
-                        pushSeq(element, Token::tokenType(element[0]), line, i - element.size(), sequence);
-                        numDecimal = 0;
-                        element="";
-                    }
+    size_t length = (newline == std::string::npos ? partial.size() : newline + 1) - partialStart;
+    std::shared_ptr<std::string> owned = std::make_shared<std::string>(partial, partialStart, length);
+    partialStart += length;
 
-                    if(element == "=" && rawInput != '='){
-                        pushSeq("=", ASSIGNMENT, line, i-1, sequence);
-                        element = rawInput;
-                    }
+    int next = scan(owned->data(), owned->size(), streamLine, line.tokens);
+    line.text = std::shared_ptr<const char>(owned, owned->data());
 
-                    else if((element == "<" || element == "=" || element == ">" || element == "!") && rawInput == '='){
-                        pushSeq(element+rawInput, COMPARE, line, i-1, sequence);
-                        element = "";
-                    }
+    if(!line.tokens.empty()) streamColumn = line.tokens.back().column;
+    streamNewline = owned->back() == '\n';
+    streamLine = next;
+    return true;
+}
 
-                    else if((element == "<" || element == ">" || element == "!") && rawInput != '='){
-                        pushSeq(element, COMPARE, line, i-1, sequence);
-                        element = rawInput;
-                    } 
+//Hands out the next top level statement of a streamed script, returns false once the script is done
+//The statement holds on to the lines it came from
+bool Lexer::nextStatement(Statement& statement){
+    SourceLine line;
 
-                    else if(Token::tokenType(rawInput)==COMPARE || rawInput == '='){
-                        pushSeq(element, Token::tokenType(element[0]), line, i-element.size(), sequence);
-                        element = rawInput;
-                    }
-                    
-                    else {
-                        std::string rawInputString(1, rawInput);
-                        pushSeq(rawInputString, type, line, i, sequence);
-                        element = "";
-                    }
-                }
-                
-                
-    
-        } else {
-            if(element == "else if" || element.substr(0, 4) != "else"){
-                pushSeq(element, Token::tokenType(element[0]), line, i - element.size(), sequence);
-                element = "";
-                numDecimal = 0;
-             } else {
-                element += " ";
-             }
-            numDecimal = 0;
+    while(!splitter.next(statement)){
+        if(!readLine(line)) return false;
+        splitter.add(line);
+    }
+
+    return true;
+}
+
+void StatementSplitter::add(SourceLine& line){
+    if(line.tokens.empty()){
+        return;
+    }
+
+    lines.push_back(PendingLine{line.text, line.tokens.size()});
+    pending.insert(pending.end(), line.tokens.begin(), line.tokens.end());
+}
+
+//Moves the next complete statement into statement, returns false if more lines are needed first
+//Scanning picks up where the last call stopped, so a long statement isn't rescanned for every line
+bool StatementSplitter::next(Statement& statement){
+    while(scanned < pending.size()){
+        const Token& token = pending[scanned];
+
+        //The block of an if chain just closed, the chain only goes on if else or else if follows
+        if(closed){
+            closed = false;
+            if(token.symbol != SYM_ELSE && token.symbol != SYM_ELSE_IF) return finish(statement);
         }
 
-        i++;
+        scanned++;
+        if(token.type == END) return finish(statement);
+        if(scanned == 1 && token.symbol == SYM_IF) ifChain = true;
+
+        if(token.token == "{"){
+            depth++;
+        } else if(token.token == ";" && depth == 0){
+            return finish(statement);
+        } else if(token.token == "}"){
+            if(depth > 0) depth--;
+            if(depth > 0) continue;
+            if(!ifChain) return finish(statement);
+            closed = true;
+        }
     }
 
-    sequence.push_back(Token{line,(int)raw.length()+1,"END", END});
-    
-    return sequence;
+    return false;
+}
+
+//Hands out the scanned tokens along with the lines they point into
+bool StatementSplitter::finish(Statement& statement){
+    statement.tokens.assign(pending.begin(), pending.begin() + scanned);
+    Lexer::matchBrackets(statement.tokens);
+    statement.sources.clear();
+    statement.error = nullptr;
+
+    pending.erase(pending.begin(), pending.begin() + scanned);
+    while(scanned > 0){
+        PendingLine& line = lines.front();
+        size_t taken = std::min(line.tokens, scanned);
+
+        if(line.text != nullptr) statement.sources.push_back(line.text);
+        line.tokens -= taken;
+        scanned -= taken;
+        if(line.tokens == 0) lines.pop_front();
+    }
+
+    depth = 0;
+    ifChain = false;
+    closed = false;
+    return true;
 }
@@ -1,17 +1,103 @@
 #ifndef LEXER_H
 #define LEXER_H
 #include <vector>
+#include <atomic>
+#include <deque>
 #include <iostream>
 #include <fstream>
+#include <memory>
+#include <string>
+#include <exception>
 #include "token.h"
+// The tokens of one line of streamed input, they point into text
+// error is set instead when the line couldn't be lexed and the line has to travel between threads
+struct SourceLine {
+    std::shared_ptr<const char> text;
+    std::vector<Token> tokens;
+    std::exception_ptr error;
+};
+
+// A complete top level statement and the lines its tokens point into
+struct Statement {
+    std::vector<Token> tokens;
+    std::vector<std::shared_ptr<const char>> sources;
+    std::exception_ptr error;
+};
+
+// Groups streamed lines into top level statements
+// A statement ends with a ; or with the } closing its block, an if chain waits to see whether else follows
+class StatementSplitter {
+    private:
+        struct PendingLine {
+            std::shared_ptr<const char> text;
+            size_t tokens;
+        };
+
+        std::deque<Token> pending;
+        std::deque<PendingLine> lines;
+        size_t scanned = 0;
+        int depth = 0;
+        bool ifChain = false;
+        bool closed = false;
+
+        bool finish(Statement& statement);
+    public:
+        void add(SourceLine& line);
+        bool next(Statement& statement);
+};
+
 class Lexer {
     private:
-        TokenType tokenType(char token);
-        void pushSeq(std::string element, TokenType type, int line, int column, std::vector<Token> &sequence);
-        void pushSeqThrow(std::string element, TokenType type, int line, int column, std::vector<Token> &sequence);
+        // Buffers the tokens point into. The lexer owns the source text, so the tokens it hands out,
+        // and statements read from them, must not outlive it. Streamed lines are shared with their statement instead,
+        // and a function shares the text of its body (see FunctionBody::sources)
+        std::vector<std::shared_ptr<const char>> sources;
+
+        // Threads a large buffer is split over (see scanParallel)
+        unsigned threads = 1;
+
+        // Streaming state (see nextStatement)
+        int streamFd = -1;
+        std::istream* streamInput = nullptr;
+        std::unique_ptr<std::istream> streamFile;
+        std::string partial;
+        size_t partialStart = 0;
+        StatementSplitter splitter;
+        int streamLine = 1;
+        int streamColumn = 0;
+        bool streamNewline = false;
+        bool streamEof = false;
+        bool streamEnded = false;
+        // set by stopStream, wakeFds is a pipe it writes to so a read waiting for input wakes up (see readMore)
+        std::atomic<bool> streamStopped{false};
+        int wakeFds[2] = {-1, -1};
+
+        [[noreturn]] void syntaxError(int line, int column);
+        const char* keep(std::string raw);
+        int scan(const char* data, size_t size, int line, std::vector<Token>& sequence);
+        int scanParallel(const char* data, size_t size, std::vector<Token>& sequence);
+        std::vector<Token> lexBuffer(const char* data, size_t size, bool fromStream);
+        bool readMore();
     public:
+        Lexer() { setThreads(0); }
+        Lexer(const Lexer&) = delete;
+        Lexer& operator=(const Lexer&) = delete;
+        ~Lexer();
+
         std::vector<Token> lexer();
         std::vector<Token> lexer(std::string raw);
+        std::vector<Token> lexFile(const std::string& path);
+        void setThreads(unsigned count);
+        static void matchBrackets(std::vector<Token>& tokens);
+
+        void openStream();
+        void openStream(const std::string& path);
+        bool readLine(SourceLine& line);
+        bool nextStatement(Statement& statement);
+        // the buffers lexFile and lexer() read into, for anything that has to hold on to them
+        const std::vector<std::shared_ptr<const char>>& buffers() const {return sources;}
+        // Ends the streamed input early, the only call that may come from another thread than the one reading
+        void stopStream();
 };
 
 
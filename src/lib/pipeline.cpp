@@ -0,0 +1,87 @@
+#include "pipeline.h"
+#include <exception>
+
+// Opens the script (stdin when path is nullptr) and starts the lexer and parser threads
+Pipeline::Pipeline(const char* path, Scrypt& scrypt) : state(std::make_shared<State>()) {
+    state->scrypt = &scrypt;
+    if (path != nullptr) state->lexer.openStream(path);
+    else state->lexer.openStream();
+
+    lexing = std::thread(lex, state);
+    parsing = std::thread(parse, state);
+}
+
+// Both threads notice stopping once they get to a ring, waking the rings stops them sleeping on one
+// and stopStream wakes the lexer thread if it is waiting for input
+Pipeline::~Pipeline() {
+    state->stopping = true;
+    state->lines.wake();
+    state->statements.wake();
+    state->lexer.stopStream();
+    parsing.join();
+    lexing.join();
+}
+
+void Pipeline::lex(std::shared_ptr<State> state) {
+    SourceLine line;
+
+    try {
+        while (state->lexer.readLine(line)) {
+            if (!state->lines.push(line, state->stopping)) break;
+        }
+    }
+    catch (...) {
+        SourceLine failed;
+        failed.error = std::current_exception();
+        state->lines.push(failed, state->stopping);
+    }
+}
+
+void Pipeline::parse(std::shared_ptr<State> state) {
+    StatementSplitter splitter;
+    SourceLine line;
+    ParsedStatement parsed;
+
+    while (state->lines.pop(line, state->stopping)) {
+        if (line.error != nullptr) {
+            parsed = ParsedStatement();
+            parsed.statement.error = line.error;
+            state->statements.push(parsed, state->stopping);
+            return;
+        }
+
+        splitter.add(line);
+
+        while (splitter.next(parsed.statement)) {
+            bool last = parsed.statement.tokens.back().type == END;
+            // a syntax error becomes a statement that throws it, so this only fails when out of memory
+            try {
+                parsed.compiled = CompiledBlock();
+                state->scrypt->prepare(parsed.statement.tokens, parsed.compiled, false, parsed.statement.sources);
+            }
+            catch (...) {
+                parsed.statement.error = std::current_exception();
+                last = true;
+            }
+
+            if (!state->statements.push(parsed, state->stopping) || last) return;
+        }
+    }
+}
+
+// Hands out the next statement, rethrowing the syntax error of the line the lexer stopped on
+bool Pipeline::nextStatement(ParsedStatement& parsed) {
+    if (finished || !state->statements.pop(parsed, state->stopping)) {
+        return false;
+    }
+
+    Statement& statement = parsed.statement;
+
+    if (statement.error != nullptr) {
+        finished = true;
+        std::rethrow_exception(statement.error);
+    }
+
+    if (statement.tokens.back().type == END) finished = true;
+    return true;
+}
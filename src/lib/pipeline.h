@@ -0,0 +1,50 @@
+#ifndef PIPELINE_H
+#define PIPELINE_H
+#include <atomic>
+#include <memory>
+#include <thread>
+#include <vector>
+#include "lexer.h"
+#include "ring.h"
+#include "run.h"
+
+// A top level statement and what the parser thread read it into
+struct ParsedStatement {
+    Statement statement;
+    CompiledBlock compiled;
+};
+
+// Streams a script through three threads: a lexer thread turns input lines into tokens,
+// a parser thread groups them into statements and reads those the way Scrypt::prepare does,
+// and the caller runs them
+// Each hand off goes through a lock-free single producer, single consumer ring, a thread that has to wait on one sleeps
+class Pipeline {
+    private:
+        // Everything the threads touch
+        struct State {
+            Lexer lexer;
+            // only prepares statements, which the caller's Scrypt does not do at the same time
+            Scrypt* scrypt;
+            Ring<SourceLine, 1024> lines;
+            Ring<ParsedStatement, 256> statements;
+            std::atomic<bool> stopping{false};
+        };
+
+        std::shared_ptr<State> state;
+        std::thread lexing;
+        std::thread parsing;
+        bool finished = false;
+
+        static void lex(std::shared_ptr<State> state);
+        static void parse(std::shared_ptr<State> state);
+    public:
+        // scrypt prepares the statements, it has to outlive the pipeline
+        Pipeline(const char* path, Scrypt& scrypt);
+        Pipeline(const Pipeline&) = delete;
+        Pipeline& operator=(const Pipeline&) = delete;
+        ~Pipeline();
+
+        bool nextStatement(ParsedStatement& parsed);
+};
+
+#endif
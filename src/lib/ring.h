@@ -0,0 +1,89 @@
+#ifndef RING_H
+#define RING_H
+#include <array>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <mutex>
+#include <thread>
+#include <utility>
+
+// Lock-free ring buffer for exactly one producer thread and one consumer thread
+// head is only written by the consumer and tail only by the producer, each on its own cache line
+template <typename T, size_t Capacity>
+class Ring {
+    private:
+        std::array<T, Capacity> slots;
+        alignas(64) std::atomic<size_t> head{0};
+        alignas(64) std::atomic<size_t> tail{0};
+
+        // A side that has to wait spins for a little while, then sleeps on changed until the other side moves
+        // sleepers lets push and pop skip the lock while nobody sleeps
+        static const int spins = 64;
+        alignas(64) std::atomic<int> sleepers{0};
+        std::mutex sleeping;
+        std::condition_variable changed;
+
+        template <typename Attempt>
+        bool wait(Attempt attempt, const std::atomic<bool>& stopping) {
+            for (int spin = 0; spin < spins; spin++) {
+                if (attempt()) return true;
+                if (stopping.load(std::memory_order_relaxed)) return false;
+                std::this_thread::yield();
+            }
+
+            std::unique_lock<std::mutex> lock(sleeping);
+            sleepers.fetch_add(1);
+            // pairs with the fence in moved, either the other side sees the sleeper or the attempt sees its move
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            bool done = false;
+            changed.wait(lock, [&] { return (done = attempt()) || stopping.load(std::memory_order_relaxed); });
+            sleepers.fetch_sub(1);
+            return done;
+        }
+
+        void moved() {
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            if (sleepers.load(std::memory_order_relaxed) != 0) wake();
+        }
+
+    public:
+        bool tryPush(T& value) {
+            size_t back = tail.load(std::memory_order_relaxed);
+            if (back - head.load(std::memory_order_acquire) == Capacity) return false;
+
+            slots[back % Capacity] = std::move(value);
+            tail.store(back + 1, std::memory_order_release);
+            return true;
+        }
+
+        bool tryPop(T& value) {
+            size_t front = head.load(std::memory_order_relaxed);
+            if (tail.load(std::memory_order_acquire) == front) return false;
+
+            value = std::move(slots[front % Capacity]);
+            head.store(front + 1, std::memory_order_release);
+            return true;
+        }
+
+        // Blocking versions, they give up (and return false) once stopping is set and wake has been called
+        bool push(T& value, const std::atomic<bool>& stopping) {
+            if (!wait([&] { return tryPush(value); }, stopping)) return false;
+            moved();
+            return true;
+        }
+
+        bool pop(T& value, const std::atomic<bool>& stopping) {
+            if (!wait([&] { return tryPop(value); }, stopping)) return false;
+            moved();
+            return true;
+        }
+
+        // Wakes a sleeping push or pop so it looks at stopping again
+        void wake() {
+            std::lock_guard<std::mutex> lock(sleeping);
+            changed.notify_all();
+        }
+};
+
+#endif
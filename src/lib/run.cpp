@@ -1,4 +1,6 @@
 #include "run.h"
+#include "stmt.h"
+#include "vm.h"
 #include <iostream>
 #include <iomanip>
 #include <vector>
@@ -7,7 +9,6 @@
 #include <sstream>
 #include <stdexcept>
 #include <memory>
-#include <variant>
 
 void Scrypt::printV(std::vector<Token> tokens){
     std::cout << "_______" << std::endl;
@@ -19,316 +20,219 @@ void Scrypt::printV(std::vector<Token> tokens){
     std::cout << "_______" << std::endl;
 }
 
-bool Scrypt::isBool(Value value){
-	if(std::holds_alternative<bool>(value)){
-		if(value == Value(true)) return true;
-		else return false;
-	}
-
-	std::ostringstream error;
-        error << "Runtime error: condition is not a bool.";
+//Finds the "}" closing the block opened at tokens[open], using the offset the lexer recorded
+static size_t blockClose(TokenSpan tokens, size_t open){
+    if(open >= tokens.size() || tokens[open].token != "{" || tokens[open].match <= 0 || open + tokens[open].match >= tokens.size()){
+        const Token& token = open < tokens.size() ? tokens[open] : tokens.back();
+        std::ostringstream error;
+        error << "Unexpected token at line " << token.line << " column " << token.column << ": " << token.token;
         throw std::runtime_error(error.str());
-	
-	//This will never happen
-	return true;
-
-}
-
-Value Scrypt::evaluateExpression(std::vector<Token> tokens, std::map<std::string, Value>& variables){
-    //Return nothing if tokens vector is empty or just END
-    if((int)tokens.size() == 0 || tokens.at(0).type == END){
-        return Value();
-    }
-
-    std::vector<Token> tempRow = tokens;
-    if(tempRow.back().type != END){
-        tempRow.push_back(Token{tempRow.back().line, tempRow.back().column+1,"END", END});
     }
 
-    InfixParser parser = InfixParser(tempRow, variables);
-    
-    return parser.calculate();
+    return open + tokens[open].match;
 }
 
-
-void Scrypt::evaluateExpressionChunk(std::vector<Token> tokens, std::map<std::string, Value>& variables){
-    if(tokens.size() == 0){
-        return;
-    }
-    std::vector<std::vector<Token>> multilineTokens;
-    
-
-
-    for(int i = 0; i < (int)tokens.size(); i++){
-        std::vector<Token> tempRow;
-        while(i < (int)tokens.size() && tokens[i].token != ";"){
-            tempRow.push_back(tokens[i]);
-            i++;
-        }
-        multilineTokens.push_back(tempRow);
+//Index of the first "{" at or after i
+static size_t findOpen(TokenSpan tokens, size_t i){
+    while(i < tokens.size() && tokens[i].token != "{"){
+        i++;
     }
 
-
-
-    for (const auto &line : multilineTokens)
-    {
-        evaluateExpression(line, variables);
-    }
+    return i;
 }
 
-bool Scrypt::isKeyword(Token token){
-    if(token.token == "print" ||
-    token.token == "def" ||
-    token.token == "return" ||
-    token.token == "while" ||
-    token.token == "else" ||
-    token.token == "else if" ||
-    token.token == "if"){
+bool Scrypt::isKeyword(const Token& token){
+    if(token.symbol == SYM_PRINT ||
+    token.symbol == SYM_DEF ||
+    token.symbol == SYM_RETURN ||
+    token.symbol == SYM_WHILE ||
+    token.symbol == SYM_ELSE ||
+    token.symbol == SYM_ELSE_IF ||
+    token.symbol == SYM_IF){
         return true;
     }
     return false;
 }
 
-Value Scrypt::parseBlock(std::vector<Token>& tokens, std::map<std::string, Value>& variables, bool inFunc) {
-    variables["len"] = nullptr;
-    variables["pop"] = nullptr;
-    variables["push"] = nullptr;
+//From now on the bodies of the defs this reads are compiled on a worker thread ahead of their first call
+void Scrypt::compileInBackground(){
+    if(background == nullptr) background.reset(new Compiler());
+}
 
-    //The last token must always have an end (to know when to terminate later)
-    if(tokens.back().type != END){
-        tokens.push_back(Token{tokens.back().line, tokens.back().column+1,"END", END});
-    }
+//From now on blocks are compiled to bytecode and run on the VM instead of walking the statements
+void Scrypt::useVM(){
+    vm = true;
+}
 
-    //prevCond is used for else and else if
-    bool prevCond = true;
-    int i = 0;
-    if((int)tokens.size() == 0) {
-        return nullptr;//nullptr;
-    }
-    
-    //Iterativly go through each token (i changes within loop based on the code)
-    while (i < (int)tokens.size()) {
-        if (tokens[i].token == "print") {
-            i++;
-            std::vector<Token> printExpr;
-            while (i < (int)tokens.size()) {
-		if(tokens[i].token == ";"){break;}
-                //printExpr.push_back(tokens[i]);
-                if(isKeyword(tokens[i])){
-                    std::cout <<"ERROR, keyword before ;"<<std::endl;
-                    break;
-                }
- 		printExpr.push_back(tokens[i]);
-                //if(tokens[i].token == ";"){ break; }
-                i++;
+//Reads the tokens into statements once, so loops and functions do not go back to the tokens
+void Scrypt::compile(TokenSpan tokens, Block& block, const std::vector<std::shared_ptr<const char>>& sources){
+    //the if chain an else or else if right after it belongs to
+    IfChain* chain = nullptr;
+    size_t i = 0;
+
+    try {
+        while (i < tokens.size()) {
+            if (tokens[i].symbol != SYM_ELSE && tokens[i].symbol != SYM_ELSE_IF && tokens[i].token != "}") {
+                chain = nullptr;
             }
 
-	    
-	    if((int)printExpr.size() > 0){
-            	std::cout << evaluateExpression(printExpr, variables) << std::endl;
-	    }
-            i++;
-        }
+            if (tokens[i].symbol == SYM_PRINT || tokens[i].symbol == SYM_RETURN) {
+                bool isPrint = tokens[i].symbol == SYM_PRINT;
+                bool cut = false;
+                i++;
+                size_t exprStart = i;
+                while (i < tokens.size()) {
+                    if(tokens[i].token == ";"){break;}
+                    if(isKeyword(tokens[i])){
+                        cut = true;
+                        break;
+                    }
+                    i++;
+                }
 
-        if (tokens[i].token == "return") {
-		
-	    if(!inFunc){
-		    std::ostringstream error;
-		    error << "Runtime error: unexpected return.";
-		    throw std::runtime_error(error.str());
-	    }
-
-            i++;
-            std::vector<Token> returnExpr;
-            while (i < (int)tokens.size()) {
-                //returnExpr.push_back(tokens[i]);
-		if(tokens[i].token == ";"){break;}
-                if(isKeyword(tokens[i])){
-                    std::cout <<"ERROR, keyword before ;"<<std::endl;
-                    break;
+                if(isPrint) block.statements.emplace_back(new PrintStmt(tokens.slice(exprStart, i), cut));
+                else {
+                    //nothing after a return can run
+                    block.statements.emplace_back(new ReturnStmt(tokens.slice(exprStart, i), cut));
+                    return;
                 }
-                returnExpr.push_back(tokens[i]);
-                //if(tokens[i].token == ";"){ break; }
                 i++;
             }
 
-	    if((int)returnExpr.size() == 0){
-	    	return nullptr;
-	    }
-            return evaluateExpression(returnExpr, variables);
-            i++;
-        }
+            else if (tokens[i].symbol == SYM_WHILE) {
+                size_t conditionStart = i + 1;
+                size_t open = findOpen(tokens, conditionStart);
+                size_t close = blockClose(tokens, open);
 
-        else if (tokens[i].token == "while") {
-            i++;
-            int conditionStart = i;
-            while (tokens[i].token != "{") {
-                i++;
-            }
-            
-            int conditionEnd = i;
-            int blockStart = i + 1;
-            int blockParen = 1;
-            while (blockParen > 0) {
-                i++;
-                if (tokens[i].token == "{") blockParen++;
-                else if (tokens[i].token == "}") blockParen--;
-            }
+                WhileStmt* statement = new WhileStmt(tokens.slice(conditionStart, open));
+                block.statements.emplace_back(statement);
+                compile(tokens.slice(open + 1, close), statement->body, sources);
 
-            int blockEnd = i;
-            std::vector<Token> conditionExpr(tokens.begin() + conditionStart, tokens.begin() + conditionEnd);
-            while (isBool(evaluateExpression(conditionExpr, variables)) == true) {
-                std::vector<Token> block(tokens.begin() + blockStart, tokens.begin() + blockEnd);
-                parseBlock(block, variables, inFunc);
-            }
-           
-        } 
-        
-        else if (tokens[i].token == "if") {
-            int conditionStart = i + 1;
-            while (tokens[i].token != "{") {
-                i++;
-            }
-            
-            std::vector<Token> conditionExpr(tokens.begin() + conditionStart, tokens.begin() + i);
-            int blockStart = i + 1;
-            int blockParen = 1;
-            while (blockParen > 0) {
-                i++;
-                if (tokens[i].token == "{") blockParen++;
-                else if (tokens[i].token == "}") blockParen--;
-            }
-            
-            if (isBool(evaluateExpression(conditionExpr, variables)) == true) {
-                std::vector<Token> block(tokens.begin() + blockStart, tokens.begin() + i); 
-                parseBlock(block, variables, inFunc);
-                prevCond = true;
-            } else{
-                prevCond = false;
+                i = close + 1;
             } 
-            i++;
-        } 
-
-        else if (tokens[i].token == "def") {
-		i++;
-		std::string funcName = "";
-		while(tokens[i].token != "(") {
-			funcName += tokens[i].token;
-			i++;
-		}
-		i++;
-            std::vector<Token> arguments;
-            bool argIndex = true;
-            while (tokens[i].token != ")") {
-                if(argIndex){
-                    arguments.push_back(tokens[i]);
-                    argIndex = false;
-                } if(tokens[i].token == ","){
-                    argIndex = true;
-                }
-                i++;
-            }
-		
-		i++;
-            
-            int blockStart = i + 1;
-            int blockParen = 1;
-            while (blockParen > 0) {
-                i++;
-                if (tokens[i].token == "{") blockParen++;
-                else if (tokens[i].token == "}") blockParen--;
-            }
-            
-	    //variables[funcName] = std::make_shared<Function>(Function());            
-            std::vector<Token> block(tokens.begin() + blockStart, tokens.begin() + i); 
- 		          
-            variables[funcName] = std::make_shared<Function>(Function(arguments, block, variables, funcName));
-	    //variables[funcName] = std::make_shared<Function>(Function{arguments, block, variables});
-	   // std::get<Func>(variables[funcName])->variables = variables;
-	    
-	    i++;
-        } 
-        
-       
-      
-
-        else if (tokens[i].token == "else if") {
-            int conditionStart = i + 1;
-            while (tokens[i].token != "{") {
-                i++;
-            }
             
-            int conditionEnd = i;
-            std::vector<Token> conditionExpr(tokens.begin() + conditionStart, tokens.begin() + conditionEnd);
-            int blockStart = i + 1;
-            int blockParen = 1;
-            while (blockParen > 0) {
-                i++;
-                if (tokens[i].token == "{") blockParen++;
-                else if (tokens[i].token == "}") blockParen--;
-            }
+            else if (tokens[i].symbol == SYM_IF || (chain != nullptr && tokens[i].symbol == SYM_ELSE_IF)) {
+                size_t conditionStart = i + 1;
+                size_t open = findOpen(tokens, conditionStart);
+                size_t close = blockClose(tokens, open);
+
+                if (tokens[i].symbol == SYM_IF) {
+                    chain = new IfChain();
+                    block.statements.emplace_back(chain);
+                }
 
-            if(prevCond == false && (isBool(evaluateExpression(conditionExpr, variables)) == true)){
-                std::vector<Token> block(tokens.begin() + blockStart, tokens.begin() + i);
-                parseBlock(block, variables, inFunc);
-                prevCond = true;
-            }
-            i++;
-        }
-        
-        else if (tokens[i].token == "else") {
+                chain->conditions.emplace_back(new Expression(tokens.slice(conditionStart, open)));
+                chain->bodies.emplace_back();
+                compile(tokens.slice(open + 1, close), chain->bodies.back(), sources);
 
-	    i++; 
-            int blockStart = i + 1;
+                i = close + 1;
+            } 
 
+            else if (chain != nullptr && tokens[i].symbol == SYM_ELSE) {
+                size_t open = i + 1;
+                size_t close = blockClose(tokens, open);
 
-	    if(tokens[blockStart].token == "}"){
-		i++;
-            } else {
+                chain->conditions.emplace_back(nullptr);
+                chain->bodies.emplace_back();
+                compile(tokens.slice(open + 1, close), chain->bodies.back(), sources);
 
-            int blockParen = 1;
-          
-            while (blockParen > 0) {
-                i++;
-                if (tokens[i].token == "{") blockParen++;
-                else if (tokens[i].token == "}") blockParen--;
-            }
-            
-            if(prevCond == false){
-                std::vector<Token> block(tokens.begin() + blockStart, tokens.begin() + i);
-                parseBlock(block, variables, inFunc);
+                i = close + 1;
+            } 
+
+            else if (tokens[i].symbol == SYM_ELSE || tokens[i].symbol == SYM_ELSE_IF) {
+                std::ostringstream error;
+                error << "Unexpected token at line " << tokens[i].line << " column " << tokens[i].column << ": " << tokens[i].token;
+                throw std::runtime_error(error.str());
             }
-	  }
-            prevCond = true;
-        } 
-        
-        else if (tokens[i].token == "}"){
-            i++;
-        } 
-        
-        else if(tokens[i].type == END){
-            return nullptr;
-        }
 
-        //Evalutate expressions that are not commands (And create vars)
-        else {
-            int blockStart = i;
-            
-            while(i < (int)tokens.size() && tokens[i].type != COMMAND && tokens[i].type != FUNCTION && tokens[i].token != "return" && tokens[i].token != "}"){
+            else if (tokens[i].symbol == SYM_DEF) {
+                std::unique_ptr<DefStmt> statement(new DefStmt());
+
                 i++;
-            }
-            int blockEnd = i;
+                while(i < tokens.size() && tokens[i].token != "(") {
+                    statement->name += tokens[i].token;
+                    i++;
+                }
+                i++;
+                std::vector<int> arguments;
+                bool argIndex = true;
+                while (i < tokens.size() && tokens[i].token != ")") {
+                    if(argIndex){
+                        arguments.emplace_back(Symbols::intern(tokens[i].token));
+                        argIndex = false;
+                    } if(tokens[i].token == ","){
+                        argIndex = true;
+                    }
+                    i++;
+                }
+                
+                size_t open = i + 1;
+                size_t close = blockClose(tokens, open);
+                statement->body = std::make_shared<FunctionBody>(tokens.slice(open + 1, close), std::move(arguments), Symbols::intern(statement->name), sources);
+                if(background != nullptr) background->add(statement->body);
+                block.statements.push_back(std::move(statement));
+
+                i = close + 1;
+            } 
             
-            std::vector<Token> block (tokens.begin() + blockStart, tokens.begin() + blockEnd);
+            else if (tokens[i].token == "}"){
+                i++;
+            } 
             
-            if((int)block.size() > 0 && block.at(0).type != END){
-                evaluateExpressionChunk(block, variables);
+            else if(tokens[i].type == END){
+                return;
+            }
+
+            //Expressions that are not commands (And create vars), one statement per ;
+            else {
+                size_t exprStart = i;
+                
+                while(i < tokens.size() && tokens[i].type != COMMAND && tokens[i].type != FUNCTION && tokens[i].symbol != SYM_RETURN && tokens[i].token != "}"){
+                    if(tokens[i].token == ";"){
+                        if(i > exprStart) block.statements.emplace_back(new ExprStmt(tokens.slice(exprStart, i)));
+                        exprStart = i + 1;
+                    }
+                    i++;
+                }
+
+                if(i > exprStart && tokens[exprStart].type != END){
+                    block.statements.emplace_back(new ExprStmt(tokens.slice(exprStart, i)));
+                }
             }
-            
         }
     }
+    catch (const std::exception& e) {
+        //a block that cannot be read stops this one at that point
+        block.statements.emplace_back(new ErrorStmt(e.what()));
+    }
+}
 
-    return nullptr;
+//Does all the reading ahead of run, it only needs the tokens so it can be on another thread than the one running
+void Scrypt::prepare(TokenSpan tokens, CompiledBlock& compiled, bool inFunc, const std::vector<std::shared_ptr<const char>>& sources) {
+    compile(tokens, compiled.block, sources);
+    if (vm) compiled.bytecode = VM::compile(compiled.block, inFunc);
 }
 
+Value Scrypt::run(const CompiledBlock& compiled, Env& variables, bool inFunc) {
+    Value result = nullptr;
+    if (compiled.bytecode != nullptr) compiled.bytecode->run(variables, result);
+    else compiled.block.execute(variables, inFunc, result);
+    return result;
+}
 
+Value Scrypt::parseBlock(TokenSpan tokens, Env& variables, bool inFunc, const std::vector<std::shared_ptr<const char>>& sources) {
+    CompiledBlock compiled;
+    prepare(tokens, compiled, inFunc, sources);
+    return run(compiled, variables, inFunc);
+}
+
+//Reads the tokens into statements like parseBlock but only reports the syntax errors, nothing is run
+std::vector<std::string> Scrypt::check(TokenSpan tokens) {
+    //nothing runs, so the functions it defines do not need the text
+    Block block;
+    compile(tokens, block, {});
+
+    std::vector<std::string> errors;
+    block.check(errors);
+    return errors;
+}
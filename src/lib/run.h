@@ -4,6 +4,9 @@
 #include "lexer.h" // cpp
 #include "infix.h" //cpp
 #include "value.h"
+#include "stmt.h"
+#include "compiler.h"
+#include "flat.h"
 #include <iostream>
 #include <iomanip>
 #include <vector>
@@ -13,14 +16,26 @@
 #include <stdexcept>
 
 
+// A block read into statements, and into bytecode too when the VM runs it
+struct CompiledBlock {
+	Block block;
+	std::unique_ptr<FlatExpr> bytecode;
+};
+
 class Scrypt {
 	private:
 		void printV(std::vector<Token> tokens);
-		Value evaluateExpression(std::vector<Token> tokens, std::map<std::string, Value>& variables);
-		void evaluateExpressionChunk(std::vector<Token> tokens, std::map<std::string, Value>& variables);
-		bool isKeyword(Token token);
-		bool isBool(Value value);
+		bool isKeyword(const Token& token);
+		std::unique_ptr<Compiler> background;
+		bool vm = false;
 	public:
-		Value parseBlock(std::vector<Token>& tokens, std::map<std::string, Value>& variables, bool inFunc);
+		void compileInBackground();
+		void useVM();
+		// sources is the text the tokens point into, the functions the block defines share it
+		void compile(TokenSpan tokens, Block& block, const std::vector<std::shared_ptr<const char>>& sources);
+		void prepare(TokenSpan tokens, CompiledBlock& compiled, bool inFunc, const std::vector<std::shared_ptr<const char>>& sources);
+		Value run(const CompiledBlock& compiled, Env& variables, bool inFunc);
+		Value parseBlock(TokenSpan tokens, Env& variables, bool inFunc, const std::vector<std::shared_ptr<const char>>& sources);
+		std::vector<std::string> check(TokenSpan tokens);
 };
 #endif
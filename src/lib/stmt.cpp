@@ -0,0 +1,210 @@
+#include "stmt.h"
+#include "run.h"
+#include "vm.h"
+#include <iostream>
+#include <sstream>
+#include <stdexcept>
+
+static bool isBool(const Value& value) {
+  if (value.isBool()) return value.boolean();
+
+  throw std::runtime_error("Runtime error: condition is not a bool.");
+}
+
+Expression::Expression(TokenSpan tokens) {
+  //Nothing to parse if the tokens are empty or just END
+  if (tokens.empty() || tokens[0].type == END) return;
+
+  try {
+    parser.reset(new InfixParser(tokens));
+  }
+  catch (const std::exception& e) {
+    error = e.what();
+  }
+}
+
+Value Expression::calculate(Env& variables) const {
+  if (!error.empty()) throw std::runtime_error(error);
+  if (parser == nullptr) return Value();
+
+  return parser->calculate(variables);
+}
+
+void Expression::check(std::vector<std::string>& errors) const {
+  if (!error.empty()) errors.push_back(error);
+}
+
+void Expression::assigned(std::vector<int>& symbols) const {
+  if (parser != nullptr) parser->assigned(symbols);
+}
+
+Stmt::~Stmt() {}
+
+void Stmt::assigned([[maybe_unused]] std::vector<int>& symbols) const {}
+
+bool Block::execute(Env& variables, bool inFunc, Value& result) const {
+  variables[SYM_LEN] = nullptr;
+  variables[SYM_POP] = nullptr;
+  variables[SYM_PUSH] = nullptr;
+
+  for (const auto& statement : statements) {
+    if (statement->execute(variables, inFunc, result)) return true;
+  }
+
+  return false;
+}
+
+bool ExprStmt::execute(Env& variables, [[maybe_unused]] bool inFunc, [[maybe_unused]] Value& result) const {
+  expression.calculate(variables);
+  return false;
+}
+
+bool PrintStmt::execute(Env& variables, [[maybe_unused]] bool inFunc, [[maybe_unused]] Value& result) const {
+  if (cut) std::cout << "ERROR, keyword before ;" << std::endl;
+  if (!empty) std::cout << expression.calculate(variables) << std::endl;
+  return false;
+}
+
+bool ReturnStmt::execute(Env& variables, bool inFunc, Value& result) const {
+  if (!inFunc) throw std::runtime_error("Runtime error: unexpected return.");
+
+  if (cut) std::cout << "ERROR, keyword before ;" << std::endl;
+  result = empty ? Value(nullptr) : expression.calculate(variables);
+  return true;
+}
+
+bool WhileStmt::execute(Env& variables, bool inFunc, Value& result) const {
+  while (isBool(condition.calculate(variables))) {
+    if (body.execute(variables, inFunc, result)) return true;
+  }
+
+  return false;
+}
+
+bool IfChain::execute(Env& variables, bool inFunc, Value& result) const {
+  for (size_t i = 0; i < bodies.size(); ++i) {
+    if (conditions[i] == nullptr || isBool(conditions[i]->calculate(variables))) {
+      return bodies[i].execute(variables, inFunc, result);
+    }
+  }
+
+  return false;
+}
+
+// only one thread compiles the body, any other that asks meanwhile waits for it
+const Block& FunctionBody::get() const {
+  std::call_once(compiled, [this]() {
+    std::unique_ptr<Block> compiling(new Block());
+    Scrypt().compile(tokens, *compiling, sources);
+
+    // the arguments take the first slots in order, then the function itself, the built in names
+    // every block resets, and whatever else the body sets
+    std::vector<int> own = {symbol, SYM_LEN, SYM_POP, SYM_PUSH};
+    compiling->assigned(own);
+
+    FrameLayout laying;
+    laying.symbols = arguments;
+    auto slot = [&laying](int variable) -> int& {
+      if ((size_t) variable >= laying.slots.size()) laying.slots.resize(variable + 1, -1);
+      return laying.slots[variable];
+    };
+
+    for (size_t i = 0; i < arguments.size(); ++i) slot(arguments[i]) = (int) i;
+    for (int variable : own) {
+      if (variable < 0 || slot(variable) >= 0) continue;
+      slot(variable) = (int) laying.symbols.size();
+      laying.symbols.push_back(variable);
+    }
+
+    layout = std::move(laying);
+    block = std::move(compiling);
+
+    //the statements keep their own copies of what they need
+    std::vector<Token>().swap(tokens);
+  });
+
+  return *block;
+}
+
+const FlatExpr& FunctionBody::code() const {
+  std::call_once(coded, [this]() { bytecode = VM::compile(get(), true); });
+  return *bytecode;
+}
+
+bool DefStmt::execute(Env& variables, [[maybe_unused]] bool inFunc, [[maybe_unused]] Value& result) const {
+  variables[body->symbol] = makeRef<Function>(body, variables);
+  return false;
+}
+
+bool ErrorStmt::execute([[maybe_unused]] Env& variables, [[maybe_unused]] bool inFunc, [[maybe_unused]] Value& result) const {
+  throw std::runtime_error(message);
+}
+
+void Block::check(std::vector<std::string>& errors) const {
+  for (const auto& statement : statements) statement->check(errors);
+}
+
+void ExprStmt::check(std::vector<std::string>& errors) const {
+  expression.check(errors);
+}
+
+void PrintStmt::check(std::vector<std::string>& errors) const {
+  expression.check(errors);
+}
+
+void ReturnStmt::check(std::vector<std::string>& errors) const {
+  expression.check(errors);
+}
+
+void WhileStmt::check(std::vector<std::string>& errors) const {
+  condition.check(errors);
+  body.check(errors);
+}
+
+void IfChain::check(std::vector<std::string>& errors) const {
+  for (size_t i = 0; i < bodies.size(); ++i) {
+    if (conditions[i] != nullptr) conditions[i]->check(errors);
+    bodies[i].check(errors);
+  }
+}
+
+void DefStmt::check(std::vector<std::string>& errors) const {
+  body->get().check(errors);
+}
+
+void Block::assigned(std::vector<int>& symbols) const {
+  for (const auto& statement : statements) statement->assigned(symbols);
+}
+
+void ExprStmt::assigned(std::vector<int>& symbols) const {
+  expression.assigned(symbols);
+}
+
+void PrintStmt::assigned(std::vector<int>& symbols) const {
+  expression.assigned(symbols);
+}
+
+void ReturnStmt::assigned(std::vector<int>& symbols) const {
+  expression.assigned(symbols);
+}
+
+void WhileStmt::assigned(std::vector<int>& symbols) const {
+  condition.assigned(symbols);
+  body.assigned(symbols);
+}
+
+void IfChain::assigned(std::vector<int>& symbols) const {
+  for (size_t i = 0; i < bodies.size(); ++i) {
+    if (conditions[i] != nullptr) conditions[i]->assigned(symbols);
+    bodies[i].assigned(symbols);
+  }
+}
+
+// the body sets its own variables when it runs, only the name is set here
+void DefStmt::assigned(std::vector<int>& symbols) const {
+  symbols.push_back(body->symbol);
+}
+
+void ErrorStmt::check(std::vector<std::string>& errors) const {
+  errors.push_back(message);
+}
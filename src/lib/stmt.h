@@ -0,0 +1,137 @@
+#ifndef STMT_H
+#define STMT_H
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <map>
+#include <mutex>
+#include "token.h"
+#include "infix.h"
+#include "value.h"
+
+// Statements are built once from the tokens of a script or function body and then run as often as needed
+// execute returns true when a return statement ran, with its value left in result
+// check collects the syntax errors that execute would raise, without running anything
+// assigned collects the variables a statement can set in the scope it runs in, which is what a function keeps in its frame
+
+// an expression parsed up front
+// a syntax error is kept and only reported when the expression is reached, like the tokens were read before
+struct Expression {
+  std::unique_ptr<InfixParser> parser;
+  std::string error;
+
+  Expression(TokenSpan tokens);
+  Value calculate(Env& variables) const;
+  void check(std::vector<std::string>& errors) const;
+  void assigned(std::vector<int>& symbols) const;
+};
+
+struct Stmt {
+  virtual ~Stmt();
+  virtual bool execute(Env& variables, bool inFunc, Value& result) const = 0;
+  virtual void check(std::vector<std::string>& errors) const = 0;
+  virtual void assigned(std::vector<int>& symbols) const;
+};
+
+struct Block {
+  std::vector<std::unique_ptr<Stmt>> statements;
+
+  bool execute(Env& variables, bool inFunc, Value& result) const;
+  void check(std::vector<std::string>& errors) const;
+  void assigned(std::vector<int>& symbols) const;
+};
+
+struct ExprStmt : public Stmt {
+  Expression expression;
+
+  ExprStmt(TokenSpan tokens) : expression(tokens) {}
+  bool execute(Env& variables, bool inFunc, Value& result) const;
+  void check(std::vector<std::string>& errors) const;
+  void assigned(std::vector<int>& symbols) const;
+};
+
+// cut is set when a keyword showed up before the ';'
+struct PrintStmt : public Stmt {
+  Expression expression;
+  bool empty;
+  bool cut;
+
+  PrintStmt(TokenSpan tokens, bool cut) : expression(tokens), empty(tokens.empty()), cut(cut) {}
+  bool execute(Env& variables, bool inFunc, Value& result) const;
+  void check(std::vector<std::string>& errors) const;
+  void assigned(std::vector<int>& symbols) const;
+};
+
+struct ReturnStmt : public Stmt {
+  Expression expression;
+  bool empty;
+  bool cut;
+
+  ReturnStmt(TokenSpan tokens, bool cut) : expression(tokens), empty(tokens.empty()), cut(cut) {}
+  bool execute(Env& variables, bool inFunc, Value& result) const;
+  void check(std::vector<std::string>& errors) const;
+  void assigned(std::vector<int>& symbols) const;
+};
+
+struct WhileStmt : public Stmt {
+  Expression condition;
+  Block body;
+
+  WhileStmt(TokenSpan tokens) : condition(tokens) {}
+  bool execute(Env& variables, bool inFunc, Value& result) const;
+  void check(std::vector<std::string>& errors) const;
+  void assigned(std::vector<int>& symbols) const;
+};
+
+// an if with the else ifs and else that follow it, the else has no condition
+struct IfChain : public Stmt {
+  std::vector<std::unique_ptr<Expression>> conditions;
+  std::vector<Block> bodies;
+
+  bool execute(Env& variables, bool inFunc, Value& result) const;
+  void check(std::vector<std::string>& errors) const;
+  void assigned(std::vector<int>& symbols) const;
+};
+
+// a def body, only its braces are matched when the def is read
+// it is read into statements the first time the function is called (or by a Compiler thread), and every copy of the function shares that
+struct FunctionBody {
+  std::vector<int> arguments;
+  // the function's own name, which it can call itself by
+  int symbol;
+  mutable std::vector<Token> tokens;
+  mutable std::unique_ptr<Block> block;
+  mutable FrameLayout layout;
+  mutable std::once_flag compiled;
+  mutable std::unique_ptr<FlatExpr> bytecode;
+  mutable std::once_flag coded;
+  // the text tokens points into, shared so a body can still be read after whatever lexed it is gone
+  std::vector<std::shared_ptr<const char>> sources;
+
+  FunctionBody(TokenSpan tokens, std::vector<int> arguments, int symbol, std::vector<std::shared_ptr<const char>> sources) : arguments(arguments), symbol(symbol), tokens(tokens.begin(), tokens.end()), sources(std::move(sources)) {}
+  // also lays out the frame
+  const Block& get() const;
+  // the body compiled for the VM, also only on the first call
+  const FlatExpr& code() const;
+};
+
+struct DefStmt : public Stmt {
+  std::string name;
+  std::shared_ptr<const FunctionBody> body;
+
+  bool execute(Env& variables, bool inFunc, Value& result) const;
+  void check(std::vector<std::string>& errors) const;
+  void assigned(std::vector<int>& symbols) const;
+};
+
+// a block whose shape could not be read, raised once execution gets there
+struct ErrorStmt : public Stmt {
+  std::string message;
+
+  ErrorStmt(std::string message) : message(message) {}
+  bool execute(Env& variables, bool inFunc, Value& result) const;
+  void check(std::vector<std::string>& errors) const;
+};
+
+#endif
@@ -1,57 +1,115 @@
-#include <iostream>
+#include <cstring>
+#include <deque>
+#include <mutex>
+#include <shared_mutex>
+#include <string>
+#include <unordered_map>
 #include "token.h"
 
-TokenType Token::tokenType(char token){
-    
-    if(token == '.' || ((int)token >= 48 && (int)token <= 57) ){
-        return NUMBER;
-    }
+namespace {
+    struct Keyword {
+        const char* text = nullptr;
+        size_t length = 0;
+        TokenType type = VARIABLE;
+        int symbol = NO_SYMBOL;
+    };
 
-    if(token == ')' || token == '(') {
-        return PARENTHESIS;
-    }
+    constexpr Keyword KEYWORDS[] = {
+        {"while", 5, COMMAND, SYM_WHILE},
+        {"if", 2, COMMAND, SYM_IF},
+        {"print", 5, COMMAND, SYM_PRINT},
+        {"else", 4, COMMAND, SYM_ELSE},
+        {"def", 3, FUNCTION, SYM_DEF},
+        {"return", 6, RETURN, SYM_RETURN},
+        {"null", 4, NILL, SYM_NULL},
+        {"true", 4, BOOL, SYM_TRUE},
+        {"false", 5, BOOL, SYM_FALSE}
+    };
 
-    if(token == ']' || token == '[') {
-        return BRACKET;
-    }
+    const size_t KEYWORD_SLOTS = 16;
 
-    if(token == '}' || token == '{') {
-        return BLOCK;
+    // Perfect hash over the keywords above, checked to be collision free at compile time
+    constexpr size_t keywordHash(const char* text, size_t length){
+        return ((unsigned char)text[0] + 3 * (unsigned char)text[length - 1] + length) % KEYWORD_SLOTS;
     }
 
-    if(token == '+' || token == '-' || token == '*' || token == '/' || token == '%') {
-        return OPERATOR;
-    }
+    struct KeywordTable {
+        Keyword slots[KEYWORD_SLOTS];
+        bool perfect = true;
 
-    if(token == ';') {
-        return SEMICOLON;
-    }
+        constexpr KeywordTable() : slots() {
+            for (const Keyword& keyword : KEYWORDS) {
+                Keyword& slot = slots[keywordHash(keyword.text, keyword.length)];
+                if (slot.text != nullptr) perfect = false;
+                slot = keyword;
+            }
+        }
+    };
 
-    if(token == ',') {
-        return COMMA;
-    }
+    constexpr KeywordTable KEYWORD_TABLE{};
+    static_assert(KEYWORD_TABLE.perfect, "keyword hash has a collision");
+
+    // Names are stored once, the deque never moves them so the map can key on views of them
+    // the lexer interns from several threads when it lexes a large file in parallel
+    struct SymbolTable {
+        std::shared_mutex lock;
+        std::deque<std::string> names;
+        std::unordered_map<std::string_view, int> ids;
+
+        SymbolTable(){
+            for (const char* name : {"while", "if", "print", "else", "else if", "def", "return", "null", "true", "false", "len", "pop", "push"}) {
+                names.emplace_back(name);
+                ids[names.back()] = (int)names.size() - 1;
+            }
+        }
+    };
 
-    if(token == '&' || token == '^' || token == '|') {
-        return LOGIC;
+    SymbolTable& symbolTable(){
+        static SymbolTable table;
+        return table;
     }
+}
+
+int Symbols::intern(std::string_view name){
+    SymbolTable& table = symbolTable();
 
-    if(token == '>' || token == '<' || token == '!'){
-        return COMPARE;
+    {
+        std::shared_lock<std::shared_mutex> reading(table.lock);
+        auto found = table.ids.find(name);
+        if(found != table.ids.end()){
+            return found->second;
+        }
     }
 
-    if(token== '='){
-        return ASSIGNMENT;
+    std::unique_lock<std::shared_mutex> writing(table.lock);
+    auto found = table.ids.find(name);
+    if(found != table.ids.end()){
+        return found->second;
     }
 
-    if(token == '_' || ((int)token >= 65 && (int)token <= 90) || ((int)token >= 97 && (int)token <= 122) ){
+    table.names.emplace_back(name);
+    int symbol = (int)table.names.size() - 1;
+    table.ids[table.names.back()] = symbol;
+    return symbol;
+}
+
+std::string_view Symbols::name(int symbol){
+    SymbolTable& table = symbolTable();
+    std::shared_lock<std::shared_mutex> reading(table.lock);
+    return table.names.at(symbol);
+}
+
+// Returns the type (and symbol) of a reserved word, or VARIABLE for anything else
+TokenType Token::keywordType(const char* text, size_t length, int& symbol){
+    if(length < 2 || length > 6){
         return VARIABLE;
     }
 
-    if((int)token)
-
-    if(isspace(token)){
-        return SPACE;
+    const Keyword& slot = KEYWORD_TABLE.slots[keywordHash(text, length)];
+    if(slot.length == length && std::memcmp(slot.text, text, length) == 0){
+        symbol = slot.symbol;
+        return slot.type;
     }
 
-    return NULLTYPE;
+    return VARIABLE;
 }
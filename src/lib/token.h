@@ -2,6 +2,9 @@
 #ifndef TOKEN_H
 #define TOKEN_H
 #include <string>
+#include <string_view>
+#include <cstddef>
+#include <vector>
 
 enum TokenType {
   NUMBER,
@@ -25,13 +28,171 @@ enum TokenType {
   NILL
 };
 
+// Interned ids of the reserved words and built in functions
+// every other identifier is given the next free id the first time it is lexed
+enum Symbol {
+  NO_SYMBOL = -1,
+  SYM_WHILE,
+  SYM_IF,
+  SYM_PRINT,
+  SYM_ELSE,
+  SYM_ELSE_IF,
+  SYM_DEF,
+  SYM_RETURN,
+  SYM_NULL,
+  SYM_TRUE,
+  SYM_FALSE,
+  SYM_LEN,
+  SYM_POP,
+  SYM_PUSH,
+  SYM_RESERVED
+};
+
+// Binary operators, set on their tokens by the lexer so the parser never compares operator text
+// OP_STOP marks the tokens that end an expression at any precedence: ")", "]" and ","
+enum Op : unsigned char {
+  OP_NONE,
+  OP_ASSIGN,
+  OP_OR,
+  OP_XOR,
+  OP_AND,
+  OP_EQ,
+  OP_NE,
+  OP_LT,
+  OP_GT,
+  OP_LE,
+  OP_GE,
+  OP_ADD,
+  OP_SUB,
+  OP_MUL,
+  OP_DIV,
+  OP_MOD,
+  OP_STOP,
+  OP_COUNT
+};
+
+struct OpInfo {
+  int precedence;
+  bool rightAssociative;
+};
+
+// Precedence climbing table, indexed by Op (OP_NONE is not an operator at all)
+inline constexpr OpInfo OPERATORS[OP_COUNT] = {
+  {-2, false},
+  {0, true},
+  {1, false},
+  {2, false},
+  {3, false},
+  {4, false}, {4, false},
+  {5, false}, {5, false}, {5, false}, {5, false},
+  {6, false}, {6, false},
+  {7, false}, {7, false}, {7, false},
+  {-1, false}
+};
+
+class Symbols {
+  public:
+    static int intern(std::string_view name);
+    static std::string_view name(int symbol);
+};
+
+// Character class of every byte, built at compile time so classifying a character is a single load
+struct CharClasses {
+  TokenType type[256];
+
+  constexpr CharClasses() : type() {
+    for (int c = 0; c < 256; ++c) type[c] = NULLTYPE;
+
+    for (int c = '0'; c <= '9'; ++c) type[c] = NUMBER;
+    for (int c = 'A'; c <= 'Z'; ++c) type[c] = VARIABLE;
+    for (int c = 'a'; c <= 'z'; ++c) type[c] = VARIABLE;
+
+    type[(int)'.'] = NUMBER;
+    type[(int)'_'] = VARIABLE;
+    type[(int)'('] = type[(int)')'] = PARENTHESIS;
+    type[(int)'['] = type[(int)']'] = BRACKET;
+    type[(int)'{'] = type[(int)'}'] = BLOCK;
+    type[(int)'+'] = type[(int)'-'] = type[(int)'*'] = type[(int)'/'] = type[(int)'%'] = OPERATOR;
+    type[(int)';'] = SEMICOLON;
+    type[(int)','] = COMMA;
+    type[(int)'&'] = type[(int)'^'] = type[(int)'|'] = LOGIC;
+    type[(int)'>'] = type[(int)'<'] = type[(int)'!'] = COMPARE;
+    type[(int)'='] = ASSIGNMENT;
+    type[(int)' '] = type[(int)'\t'] = type[(int)'\n'] = type[(int)'\v'] = type[(int)'\f'] = type[(int)'\r'] = SPACE;
+  }
+};
+
+inline constexpr CharClasses CHAR_CLASSES{};
+
 class Token {
   public:  
-    static TokenType tokenType(char token);
+    static TokenType tokenType(char token) { return CHAR_CLASSES.type[(unsigned char)token]; }
+    static TokenType keywordType(const char* text, size_t length, int& symbol);
+    static constexpr Op opOf(std::string_view text);
     int line;
     int column;
-    std::string token;
+    // Points into the lexer's source text (see Lexer::sources), or a string literal for END and else if
+    std::string_view token;
     TokenType type;
-  
+    int symbol = NO_SYMBOL;
+    // Value of a NUMBER, converted once by the lexer
+    double number = 0;
+    // Offset from a bracket, parenthesis or brace to its partner, 0 when it has none (see Lexer::matchBrackets)
+    int match = 0;
+    Op op = OP_NONE;
+};
+
+constexpr Op Token::opOf(std::string_view text) {
+  if (text.size() == 2) {
+    if (text[1] != '=') return OP_NONE;
+
+    switch (text[0]) {
+      case '=': return OP_EQ;
+      case '!': return OP_NE;
+      case '<': return OP_LE;
+      case '>': return OP_GE;
+      default: return OP_NONE;
+    }
+  }
+
+  if (text.size() != 1) return OP_NONE;
+
+  switch (text[0]) {
+    case '=': return OP_ASSIGN;
+    case '|': return OP_OR;
+    case '^': return OP_XOR;
+    case '&': return OP_AND;
+    case '<': return OP_LT;
+    case '>': return OP_GT;
+    case '+': return OP_ADD;
+    case '-': return OP_SUB;
+    case '*': return OP_MUL;
+    case '/': return OP_DIV;
+    case '%': return OP_MOD;
+    case ')': case ']': case ',': return OP_STOP;
+    default: return OP_NONE;
+  }
+}
+
+// Non-owning view of a run of tokens, slicing one never copies
+class TokenSpan {
+  const Token* first = nullptr;
+  size_t count = 0;
+
+  public:
+    TokenSpan() {}
+    TokenSpan(const Token* first, size_t count) : first(first), count(count) {}
+    TokenSpan(const std::vector<Token>& tokens) : first(tokens.data()), count(tokens.size()) {}
+
+    const Token& operator[](size_t i) const { return first[i]; }
+    const Token* begin() const { return first; }
+    const Token* end() const { return first + count; }
+    const Token& front() const { return first[0]; }
+    const Token& back() const { return first[count - 1]; }
+    size_t size() const { return count; }
+    bool empty() const { return count == 0; }
+
+    // tokens [start, stop)
+    TokenSpan slice(size_t start, size_t stop) const { return TokenSpan(first + start, stop - start); }
 };
 #endif
@@ -1,106 +1,284 @@
 #include <iostream>
 #include <memory>
 #include <string>
-#include <variant>
 #include <sstream>
 #include <map>
 #include <vector>
-#include "run.h"
+#include "stmt.h"
 #include <stdexcept>
+#include <cstdint>
+#include <cmath>
 
-Value Function::getValue(std::vector<Value> argVals){
+#if defined(__unix__) || defined(__APPLE__)
+#include <sys/resource.h>
+#define VALUE_POSIX 1
+#endif
 
-  if((int)arguments.size() != (int)argVals.size()){
+std::vector<Value>& valueStack(){
+  thread_local std::vector<Value> stack;
+  return stack;
+}
+
+size_t& callDepth(){
+  thread_local size_t depth = 0;
+  return depth;
+}
+
+size_t maxCallDepth = 1000000;
+
+void enterCall(){
+  if(callDepth() >= maxCallDepth) throw std::runtime_error("Runtime error: stack overflow.");
+  callDepth()++;
+}
+
+//most of what the system lets the stack grow to, the last eighth covers everything that runs between two calls
+static uintptr_t nativeStackLimit(){
+  static const uintptr_t limit = [](){
+    uintptr_t size = 8 << 20;
+#ifdef VALUE_POSIX
+    struct rlimit stackLimit;
+    if(getrlimit(RLIMIT_STACK, &stackLimit) == 0 && stackLimit.rlim_cur != RLIM_INFINITY) size = stackLimit.rlim_cur;
+#endif
+    return size - size / 8;
+  }();
+  return limit;
+}
+
+//a call made through Function::call nests on the C++ stack (the tree engine, or a call from a tree node)
+//so those also stop with a stack overflow while there is still room on it
+static void checkNativeStack(){
+  thread_local uintptr_t top = 0;
+  char here;
+  uintptr_t address = (uintptr_t) &here;
+
+  if(top == 0) top = address;
+  if(top > address && top - address > nativeStackLimit()) throw std::runtime_error("Runtime error: stack overflow.");
+}
+
+Env::Env(const Env& other) : root(other.root), height(other.height){
+  if(other.layout == nullptr) return;
+
+  for(int symbol : other.layout->symbols){
+    const Value* value = other.local(symbol);
+    if(!unset(*value)) (*this)[symbol] = *value;
+  }
+}
+
+Value Function::call(size_t count){
+  std::vector<Value>& stack = valueStack();
+  size_t base = stack.size() - count;
+
+  if(body->arguments.size() != count){
+	stack.resize(base);
 	std::ostringstream error;
 	error << "Runtime error: incorrect argument count.";
 	throw std::runtime_error(error.str());
   }
 
-  std::map<std::string, Value> variablesCopy = variables;
-  if((int)block.size() == 0){
+  const Block& block = body->get();
+  if((int)block.statements.size() == 0){
+	  stack.resize(base);
 	  return nullptr;
   }
-  //Combine the var names and value arguments to make variables
-  for(int i = 0; i < (int)argVals.size(); i++){
-     //Add these variables to the map
-     variablesCopy[arguments[i].token] = argVals[i];
+
+  checkNativeStack();
+  enterCall();
+
+  //The arguments are already the first slots of the frame, the rest start out unset
+  const FrameLayout& layout = body->layout;
+  stack.resize(base + layout.symbols.size(), Func());
+  Env frame(variables, layout, stack, base);
+
+ //the function can call itself, it keeps its count so it can hand out itself
+ frame[body->symbol] = Func(this);
+
+  Value result = nullptr;
+  try {
+    if(vm) body->code().run(frame, result);
+    else block.execute(frame, true, result);
+  }
+  catch (...) {
+    stack.resize(base);
+    callDepth()--;
+    throw;
   }
- variablesCopy[n] = std::make_shared<Function>(Function(arguments, block, variables, n));
-  Scrypt scrypt = Scrypt();
-  return scrypt.parseBlock(block, variablesCopy, true);
+
+  stack.resize(base);
+  callDepth()--;
+  return result;
 }
 
 
-Function::Function(std::vector<Token> arguments_a, std::vector<Token> block_a, std::map<std::string, Value> variables_a, std::string name){
-     arguments = arguments_a;
-     block = block_a;
-     variables = variables_a;
-    n = name;
-    
+Function::Function(std::shared_ptr<const FunctionBody> body_a, const Env& variables_a) : body(body_a), variables(variables_a){
      //std::cout << name;
      //variables[name] = std::shared_ptr<Function>(this);
 }
 
 
+// deleting a function or array drops the values it holds, which can delete more of them in turn
+// those are queued and deleted one after another, so a long chain like a = [a] in a loop does not need a deep stack
+void Value::destroy(){
+  thread_local std::vector<uint64_t> pending;
+  thread_local bool deleting = false;
+
+  if(deleting){
+    pending.push_back(bits);
+    return;
+  }
+
+  deleting = true;
+  Value dead;
+  dead.bits = bits;
+  while(true){
+    if(dead.isFunction()) delete dead.function();
+    else delete dead.array();
+
+    if(pending.empty()) break;
+    dead.bits = pending.back();
+    pending.pop_back();
+  }
+  // already deleted, not dropped again
+  dead.bits = 0;
+  deleting = false;
+}
+
+List::List(std::vector<Value>::iterator first, std::vector<Value>::iterator last){
+  for(std::vector<Value>::iterator element = first; element != last; ++element){
+    if(!element->isNumber()) packed = false;
+  }
+
+  if(packed){
+    numbers.reserve(last - first);
+    for(std::vector<Value>::iterator element = first; element != last; ++element) numbers.push_back(element->number());
+  }
+  else values.assign(std::make_move_iterator(first), std::make_move_iterator(last));
+}
+
+void List::unpack(){
+  values.reserve(numbers.size());
+  for(double number : numbers) values.push_back(number);
+
+  numbers = std::vector<double>();
+  packed = false;
+}
+
+void List::set(size_t index, Value value){
+  //working out the new value can pop the element the index was checked against
+  if(index >= size()) throw std::runtime_error("Runtime error: index out of bounds.");
+
+  if(packed){
+    if(value.isNumber()){
+      numbers[index] = value.number();
+      return;
+    }
+    unpack();
+  }
+
+  values[index] = std::move(value);
+}
+
+void List::push(Value value){
+  if(packed){
+    if(value.isNumber()){
+      numbers.push_back(value.number());
+      return;
+    }
+    unpack();
+  }
+
+  values.push_back(std::move(value));
+}
+
+Value List::pop(){
+  if(packed){
+    double last = numbers.back();
+    numbers.pop_back();
+    return last;
+  }
+
+  Value last = std::move(values.back());
+  values.pop_back();
+  return last;
+}
+
+size_t List::index(const Value& index) const{
+  if(!index.isNumber()) throw std::runtime_error("Runtime error: index is not a number.");
+
+  double arrayIndex = index.number();
+
+  //the usual case, a whole number in range, only needs a conversion and a compare
+  if(arrayIndex >= 0 && arrayIndex < size() && (double) (size_t) arrayIndex == arrayIndex) return (size_t) arrayIndex;
+
+  if(std::fmod(arrayIndex, 1) != 0) throw std::runtime_error("Runtime error: index is not an integer.");
+  throw std::runtime_error("Runtime error: index out of bounds.");
+}
+
+bool operator==(const List& lhs, const List& rhs){
+  if(lhs.packed && rhs.packed) return lhs.numbers == rhs.numbers;
+  if(lhs.size() != rhs.size()) return false;
+
+  for(size_t i = 0; i < lhs.size(); ++i){
+    if(lhs.get(i) != rhs.get(i)) return false;
+  }
+
+  return true;
+}
+
+std::ostream& operator<<(std::ostream& os, const List& list){
+  os << "[";
+
+  for(size_t i = 0; i < list.size(); ++i){
+    if(i != 0) os << ", ";
+    if(list.packed) os << list.numbers[i];
+    else os << list.values[i];
+  }
+
+  os << "]";
+  return os;
+}
+
 std::ostream& operator << (std::ostream& os, const Value& value) {
    //Don't compare functions
-   if (std::holds_alternative<Func>(value)) {
+   if (value.isFunction()) {
     return os;
   }
 
-  if (std::holds_alternative<std::nullptr_t>(value)) {
+  if (value.isNull()) {
     os << "null";
     return os;
   }
 
-  else if (std::holds_alternative<bool>(value)) {
-    if (std::get<bool>(value)) os << "true";
+  else if (value.isBool()) {
+    if (value.boolean()) os << "true";
     else os << "false";
 
     return os;
   }
 
-  std::visit([&os](const auto& tempValue) -> void {
-    if constexpr (std::is_same_v<std::decay_t<decltype(tempValue)>, Array>) {
-      const std::vector<Value>& tempValues = *tempValue;
-      os << "[";
-
-	for (size_t i = 0; i < tempValues.size(); ++i) {
-  		if (i != tempValues.size() - 1) os << tempValues.at(i) << ", ";
-  		else os << tempValues.at(i);
-	}
-      os << "]";
-    }
-
-    else os << tempValue;
+  else if (value.isArray()) {
+    os << *value.array();
+  }
 
-  }, value);
+  else os << value.number();
 
   return os;
 }
 
-//Base type for value (Used  in the == operator)
-using ValueBase = std::variant<double,
-                               bool,
-                               std::shared_ptr<Function>,
-                               std::shared_ptr<std::vector<Value>>,
-			       std::nullptr_t>;
-
 bool operator == (const Value& lhs, const Value& rhs){
-	const Array *a = std::get_if<Array>(&lhs);
-	const Array *b = std::get_if<Array>(&rhs);
+	if(lhs.isArray() && rhs.isArray()){
+		return (*lhs.array() == *rhs.array());
+	}
 
-	if(a != nullptr && b != nullptr){
-		return (**a == **b);
+	//numbers compare as doubles (0 and -0 are equal, NaN is not equal to itself)
+	if(lhs.isNumber() && rhs.isNumber()){
+		return lhs.number() == rhs.number();
 	}
 
-	return ((const ValueBase) lhs == (const ValueBase) rhs);
+	//anything else is equal when it is the same kind with the same bool or the same function
+	return lhs.bits == rhs.bits;
 }
 
 bool operator!=(const Value& lhs, const Value& rhs) {
 	return !(lhs == rhs);
 
- }
-
-
-
+ }
\ No newline at end of file
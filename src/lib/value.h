@@ -1,38 +1,301 @@
 #ifndef VALUE_H
 #define VALUE_H
-#include <variant>
+#include <cstdint>
+#include <cstring>
 #include <memory>
 #include <ostream>
+#include <type_traits>
+#include <utility>
 #include <vector>
 #include "token.h"
 #include <sstream>
 #include <map>
 
-struct Value;
+class Function;
+struct FunctionBody;
+struct List;
+
+// what a Func or Array points to keeps its own reference count, so holding one is a single pointer
+// the count is not atomic: functions and arrays are only made and shared by the thread running the script
+struct Counted {
+    uint32_t references = 0;
+
+    Counted() {}
+    // a copy is a new object, nothing refers to it yet
+    Counted(const Counted&) {}
+    Counted& operator=(const Counted&) {return *this;}
+};
+
+// shared_ptr for Counted objects
+template<typename T>
+class Ref {
+    T* pointer = nullptr;
 
-class Function {
     public:
-	std::string n;
-        std::vector<Token> arguments;
-        std::vector<Token> block;
-        std::map<std::string, Value> variables;
-        Value getValue(std::vector<Value> argVals);
-	Function(std::vector<Token> arguments_a, std::vector<Token> block_a, std::map<std::string, Value> variables_a, std::string name);
+        Ref() {}
+        Ref(std::nullptr_t) {}
+        explicit Ref(T* pointer_a) : pointer(pointer_a) {if (pointer != nullptr) pointer->references++;}
+        Ref(const Ref& other) : Ref(other.pointer) {}
+        Ref(Ref&& other) noexcept : pointer(other.pointer) {other.pointer = nullptr;}
+        ~Ref() {if (pointer != nullptr && --pointer->references == 0) delete pointer;}
+
+        Ref& operator=(Ref other) {std::swap(pointer, other.pointer); return *this;}
+
+        T* get() const {return pointer;}
+        T& operator*() const {return *pointer;}
+        T* operator->() const {return pointer;}
+        explicit operator bool() const {return pointer != nullptr;}
+        bool operator==(const Ref& other) const {return pointer == other.pointer;}
+        bool operator!=(const Ref& other) const {return pointer != other.pointer;}
+
+        // hands this reference over to the caller, who has to drop it with another Ref or a Value
+        T* release() {T* released = pointer; pointer = nullptr; return released;}
 };
 
-//class Function;
-struct Value : public std::variant<
-  double, 
-  bool,
-  std::shared_ptr<Function>,
-  std::shared_ptr<std::vector<Value>>,//,
-  std::nullptr_t
-> {
-  using variant::variant;
+template<typename T, typename... Arguments>
+Ref<T> makeRef(Arguments&&... arguments) {
+    return Ref<T>(new T(std::forward<Arguments>(arguments)...));
+}
+
+using Array = Ref<List>;
+using Func = Ref<Function>;
+
+// A number, bool, null, function or array in 8 bytes
+// a number is its own double, the other kinds are NaNs no arithmetic makes: sign, exponent and the top two
+// fraction bits all set, then the kind in the next two bits and the bool or the pointer in the low 48
+// pointers fit in 48 bits on the 64 bit systems this runs on
+class Value {
+    static constexpr uint64_t BOXED = 0xFFFC000000000000;
+    static constexpr uint64_t NULL_BITS = BOXED;
+    static constexpr uint64_t BOOL_BITS = BOXED | (uint64_t) 1 << 48;
+    static constexpr uint64_t FUNCTION_BITS = BOXED | (uint64_t) 2 << 48;
+    static constexpr uint64_t ARRAY_BITS = BOXED | (uint64_t) 3 << 48;
+    static constexpr uint64_t PAYLOAD = ((uint64_t) 1 << 48) - 1;
+
+    uint64_t bits = 0;
+
+    // the function or array, still counted, nullptr for the other kinds and an empty Func
+    Counted* counted() const {
+        if (bits < FUNCTION_BITS) return nullptr;
+        return reinterpret_cast<Counted*>((uintptr_t) (bits & PAYLOAD));
+    }
+
+    void retain() const {
+        if (Counted* object = counted()) object->references++;
+    }
+
+    void drop() {
+        Counted* object = counted();
+        if (object != nullptr && --object->references == 0) destroy();
+    }
+
+    // deletes the function or array once the last value holding it is gone
+    void destroy();
+
+    static uint64_t box(uint64_t kind, Counted* object) {
+        return kind | ((uintptr_t) object & PAYLOAD);
+    }
+
+    public:
+        // 0, like the variant this replaced
+        Value() {}
+        Value(double number) {
+            std::memcpy(&bits, &number, sizeof bits);
+            // a NaN that looks like another kind keeps its sign and loses its payload, it prints the same
+            if (bits >= BOXED) bits = 0xFFF8000000000000;
+        }
+        // only an actual bool, a pointer should not quietly turn into one
+        template<typename T, typename std::enable_if<std::is_same<T, bool>::value, int>::type = 0>
+        Value(T boolean) : bits(BOOL_BITS | (uint64_t) boolean) {}
+        Value(std::nullptr_t) : bits(NULL_BITS) {}
+        Value(Func function);
+        Value(Array array);
+
+        Value(const Value& other) : bits(other.bits) {retain();}
+        Value(Value&& other) noexcept : bits(other.bits) {other.bits = 0;}
+        ~Value() {drop();}
+
+        // other is a copy, so assigning a value something this one holds still works
+        Value& operator=(Value other) {std::swap(bits, other.bits); return *this;}
+
+        bool isNumber() const {return bits < BOXED;}
+        bool isBool() const {return (bits & ~PAYLOAD) == BOOL_BITS;}
+        bool isNull() const {return bits == NULL_BITS;}
+        bool isFunction() const {return (bits & ~PAYLOAD) == FUNCTION_BITS;}
+        bool isArray() const {return (bits & ~PAYLOAD) == ARRAY_BITS;}
+        // an empty Func, what a variable that was never set holds
+        bool isUnset() const {return bits == FUNCTION_BITS;}
+
+        // these only read the kind they are named after, check it first
+        double number() const {double number; std::memcpy(&number, &bits, sizeof number); return number;}
+        bool boolean() const {return bits & 1;}
+        Function* function() const;
+        List* array() const;
+
+        friend bool operator==(const Value& lhs, const Value& rhs);
+};
+
+static_assert(sizeof(Value) == 8, "a Value is one double wide");
+
+// the elements of an array
+// while every element is a number they are kept as plain doubles, the first other value stored turns them into Values
+class List : public Counted {
+    bool packed = true;
+    std::vector<double> numbers;
+    std::vector<Value> values;
+
+    void unpack();
+
+    public:
+        List() {}
+        // moves the values in [first, last) into the array
+        List(std::vector<Value>::iterator first, std::vector<Value>::iterator last);
+
+        size_t size() const {return packed ? numbers.size() : values.size();}
+        Value get(size_t index) const {return packed ? Value(numbers[index]) : values[index];}
+        void set(size_t index, Value value);
+        void push(Value value);
+        // the array is not empty
+        Value pop();
+
+        // the element index refers to, throws the script's error when it is not a whole number in range
+        size_t index(const Value& index) const;
+
+        friend bool operator==(const List& lhs, const List& rhs);
+        friend std::ostream& operator<<(std::ostream& stream, const List& list);
+};
+
+// The values of every expression and the frames of every call running on this thread
+std::vector<Value>& valueStack();
+
+// how many calls are running on this thread, a script that goes deeper than maxCallDepth stops with a stack overflow
+size_t& callDepth();
+extern size_t maxCallDepth;
+// counts a call that is starting, throws instead when there is no room left for it
+void enterCall();
+
+// where a function keeps its own variables (its arguments and whatever its body assigns) in its frame
+// worked out once from the body, anything else the function reads comes from the scope it was defined in
+struct FrameLayout {
+    // symbol of each slot, the arguments come first in order
+    std::vector<int> symbols;
+    // slot of each symbol, -1 for the ones that are not the function's own
+    std::vector<int> slots;
+};
+
+// Variables indexed by their symbol (see Symbols), so reading or writing one is a few array indexes instead of a map search
+// the slots are the leaves of a 32 way tree whose nodes are shared between copies, so copying an Env (a def capturing
+// its scope, or a call starting from it) is one reference count, and a write only copies the nodes on its path
+// that some other copy still holds
+// a running call adds its frame on top, the function's own variables live there on the value stack instead
+// a slot holding an empty Func has never been set, the names are only looked up again for error messages
+class Env {
+    static constexpr int BITS = 5;
+    static constexpr int WIDTH = 1 << BITS;
+
+    struct Leaf {
+        Value values[WIDTH];
+        Leaf() {for (Value& value : values) value = Func();}
+    };
+
+    // children are Leafs on the level above the leaves, Branches above that
+    struct Branch {
+        std::shared_ptr<void> children[WIDTH];
+    };
+
+    std::shared_ptr<void> root;
+    // number of Branch levels above the leaves
+    int height = 0;
+
+    // the running call's frame, which starts at base on the stack
+    const FrameLayout* layout = nullptr;
+    std::vector<Value>* stack = nullptr;
+    size_t base = 0;
+
+    template<typename T>
+    static T& own(std::shared_ptr<void>& node) {
+        if (node == nullptr) node = std::make_shared<T>();
+        else if (node.use_count() != 1) node = std::make_shared<T>(*static_cast<T*>(node.get()));
+        return *static_cast<T*>(node.get());
+    }
+
+    static bool unset(const Value& value) {
+        return value.isUnset();
+    }
+
+    // the frame slot of a variable, nullptr when it is not the function's own
+    Value* local(int symbol) const {
+        if (layout == nullptr || (size_t) symbol >= layout->slots.size() || layout->slots[symbol] < 0) return nullptr;
+        return &(*stack)[base + layout->slots[symbol]];
+    }
+
+    public:
+        Env() {}
+        // a call of a function defined in scope, its frame has already been pushed
+        Env(const Env& scope, const FrameLayout& layout_a, std::vector<Value>& stack_a, size_t base_a)
+            : root(scope.root), height(scope.height), layout(&layout_a), stack(&stack_a), base(base_a) {}
+        // a copy outlives the call it was made in, so the frame's variables are written into it
+        Env(const Env& other);
+        Env(Env&&) = default;
+        Env& operator=(const Env&) = delete;
+        Env& operator=(Env&&) = default;
+
+        // nullptr when the variable has never been set
+        const Value* find(int symbol) const {
+            // a variable of the function that it has not set yet still reads from the scope
+            const Value* slot = local(symbol);
+            if (slot != nullptr && !unset(*slot)) return slot;
+
+            if (root == nullptr || (size_t) symbol >> (BITS * (height + 1)) != 0) return nullptr;
+
+            const void* node = root.get();
+            for (int level = height; level > 0; --level) {
+                node = static_cast<const Branch*>(node)->children[(symbol >> (BITS * level)) & (WIDTH - 1)].get();
+                if (node == nullptr) return nullptr;
+            }
+
+            const Value& value = static_cast<const Leaf*>(node)->values[symbol & (WIDTH - 1)];
+            if (unset(value)) return nullptr;
+            return &value;
+        }
+
+        // for setting a variable, like the map this replaced
+        Value& operator[](int symbol) {
+            Value* slot = local(symbol);
+            if (slot != nullptr) return *slot;
+
+            while ((size_t) symbol >> (BITS * (height + 1)) != 0) {
+                std::shared_ptr<Branch> taller = std::make_shared<Branch>();
+                taller->children[0] = std::move(root);
+                root = std::move(taller);
+                height++;
+            }
+
+            std::shared_ptr<void>* node = &root;
+            for (int level = height; level > 0; --level) {
+                node = &own<Branch>(*node).children[(symbol >> (BITS * level)) & (WIDTH - 1)];
+            }
+
+            return own<Leaf>(*node).values[symbol & (WIDTH - 1)];
+        }
+};
+
+//body is read into statements the first time any copy of the function is called
+class Function : public Counted {
+    public:
+        std::shared_ptr<const FunctionBody> body;
+        Env variables;
+        //set for functions defined by the VM, their body runs there too
+        bool vm = false;
+        //the top count values on the value stack are the arguments, they are popped before it returns
+        Value call(size_t count);
+	Function(std::shared_ptr<const FunctionBody> body_a, const Env& variables_a);
 };
 
-using Array = std::shared_ptr<std::vector<Value>>;
-using Func = std::shared_ptr<Function>;
+inline Value::Value(Func function) : bits(box(FUNCTION_BITS, function.release())) {}
+inline Value::Value(Array array) : bits(box(ARRAY_BITS, array.release())) {}
+inline Function* Value::function() const {return static_cast<Function*>(counted());}
+inline List* Value::array() const {return static_cast<List*>(counted());}
 
 std::ostream& operator << (std::ostream& stream, const Value& value);
 
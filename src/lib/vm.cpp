@@ -0,0 +1,108 @@
+#include "vm.h"
+
+std::unique_ptr<FlatExpr> VM::compile(const Block& block, bool inFunc) {
+    std::unique_ptr<FlatExpr> code(new FlatExpr());
+    VM vm(*code, inFunc);
+
+    vm.block(block);
+    code->emit(F_END);
+    return code;
+}
+
+//A jump whose target is not known yet, land fills it in
+size_t VM::jump(FlatOp op) {
+    code.emit(op);
+    return code.nodes.size() - 1;
+}
+
+//Points the jump at the next instruction
+void VM::land(size_t at) {
+    code.nodes[at].a = (uint32_t) code.nodes.size();
+}
+
+//Leaves the expression's value on the stack, a syntax error is only raised when it is reached
+void VM::expression(const Expression& expression) {
+    if (!expression.error.empty()) code.emit(F_THROW, code.name(expression.error));
+    else if (expression.parser == nullptr) code.emit(F_CONST, code.constant(Value()));
+    else code.append(expression.parser->code());
+}
+
+//Mirrors Block::execute and the execute of each statement
+void VM::block(const Block& block) {
+    code.emit(F_RESET);
+
+    for (const auto& statement : block.statements) {
+        if (const ExprStmt* expr = dynamic_cast<const ExprStmt*>(statement.get())) {
+            expression(expr->expression);
+            code.emit(F_DROP);
+        }
+
+        else if (const PrintStmt* print = dynamic_cast<const PrintStmt*>(statement.get())) {
+            if (print->cut) code.emit(F_MESSAGE, code.name("ERROR, keyword before ;"));
+
+            if (!print->empty) {
+                expression(print->expression);
+                code.emit(F_PRINT);
+            }
+        }
+
+        else if (const ReturnStmt* ret = dynamic_cast<const ReturnStmt*>(statement.get())) {
+            if (!inFunc) {
+                code.emit(F_THROW, code.name("Runtime error: unexpected return."));
+                continue;
+            }
+
+            if (ret->cut) code.emit(F_MESSAGE, code.name("ERROR, keyword before ;"));
+
+            if (ret->empty) code.emit(F_RETURN, 0, 0, 1);
+            else {
+                expression(ret->expression);
+
+                //a call whose value is returned straight away can take over this call's frame
+                FlatNode& last = code.nodes.back();
+                if (last.op == F_CALL || (last.op == F_LOAD && last.flags == LOAD_NO_ARGS)) last.tail = true;
+                code.emit(F_RETURN);
+            }
+        }
+
+        else if (const WhileStmt* loop = dynamic_cast<const WhileStmt*>(statement.get())) {
+            uint32_t top = (uint32_t) code.nodes.size();
+            expression(loop->condition);
+            size_t exit = jump(F_BRANCH);
+
+            this->block(loop->body);
+            code.emit(F_JUMP, top);
+            land(exit);
+        }
+
+        else if (const IfChain* chain = dynamic_cast<const IfChain*>(statement.get())) {
+            std::vector<size_t> ends;
+
+            for (size_t i = 0; i < chain->bodies.size(); i++) {
+                //else
+                if (chain->conditions[i] == nullptr) {
+                    this->block(chain->bodies[i]);
+                    break;
+                }
+
+                expression(*chain->conditions[i]);
+                size_t skip = jump(F_BRANCH);
+
+                this->block(chain->bodies[i]);
+                ends.push_back(jump(F_JUMP));
+                land(skip);
+            }
+
+            for (size_t end : ends) land(end);
+        }
+
+        else if (const DefStmt* def = dynamic_cast<const DefStmt*>(statement.get())) {
+            code.defs.push_back(def);
+            code.emit(F_DEF, (uint32_t) code.defs.size() - 1);
+        }
+
+        else if (const ErrorStmt* error = dynamic_cast<const ErrorStmt*>(statement.get())) {
+            code.emit(F_THROW, code.name(error->message));
+        }
+    }
+}
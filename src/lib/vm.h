@@ -0,0 +1,25 @@
+#ifndef VM_H
+#define VM_H
+#include <memory>
+#include "flat.h"
+#include "stmt.h"
+
+// Compiles a block of statements into one FlatExpr: the flat code of each expression is copied in,
+// and loops, if chains and returns become jumps, so the whole block runs in FlatExpr::run's single loop
+// function bodies are compiled the first time they are called (see FunctionBody::code)
+class VM {
+    private:
+        FlatExpr& code;
+        bool inFunc;
+
+        VM(FlatExpr& code, bool inFunc) : code(code), inFunc(inFunc) {}
+
+        void block(const Block& block);
+        void expression(const Expression& expression);
+        size_t jump(FlatOp op);
+        void land(size_t at);
+    public:
+        static std::unique_ptr<FlatExpr> compile(const Block& block, bool inFunc);
+};
+
+#endif
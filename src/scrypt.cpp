@@ -1,4 +1,6 @@
 #include "lib/run.h"
+#include "lib/pipeline.h"
+#include "lib/check.h"
 #include <iostream>
 #include <iomanip>
 #include <vector>
@@ -6,12 +8,169 @@
 #include <map>
 #include <sstream>
 #include <stdexcept>
+#include <string>
+#include <thread>
+
+// A Lexer only hands out tokens, so the statement is read here on the thread that runs it
+bool nextStatement(Lexer& lexer, Scrypt& scrypt, ParsedStatement& parsed) {
+    if (!lexer.nextStatement(parsed.statement)) return false;
+
+    parsed.compiled = CompiledBlock();
+    scrypt.prepare(parsed.statement.tokens, parsed.compiled, false, parsed.statement.sources);
+    return true;
+}
+
+// A Pipeline has already read it on its parser thread
+bool nextStatement(Pipeline& pipeline, [[maybe_unused]] Scrypt& scrypt, ParsedStatement& parsed) {
+    return pipeline.nextStatement(parsed);
+}
+
+// Runs each top level statement as soon as it has been read instead of lexing the whole script first
+// only one statement (plus any function definitions) is held in memory at a time
+// source is a Lexer (everything on this thread) or a Pipeline (lexing and parsing on their own threads)
+template <typename Source>
+int stream(Source& source, Scrypt& scrypt) {
+    Env variables;
+    ParsedStatement parsed;
+
+    while (true) {
+        try {
+            if (!nextStatement(source, scrypt, parsed)) break;
+        }
+        catch (const std::exception& e) {
+          std::cout << e.what() << std::endl;
+          return 1;
+        }
+
+        try {
+            scrypt.run(parsed.compiled, variables, false);
+        }
+        catch (const std::exception& e) {
+          std::cout << e.what() << std::endl;
+          return 3;
+        }
+    }
+
+    return 0;
+}
+
+// Reports the syntax errors of every script (or stdin) without running any of them
+// exits 1 if a script could not be lexed, 2 if one could not be parsed
+int check(const std::vector<std::string>& paths) {
+    Checker checker = Checker();
+    std::vector<CheckResult> results;
+
+    if (paths.empty()) results.push_back(checker.checkInput());
+    else results = checker.checkFiles(paths);
+
+    int status = 0;
+    for (const CheckResult& result : results) {
+        for (const std::string& error : result.errors) {
+            if (!result.path.empty()) std::cout << result.path << ": ";
+            std::cout << error << std::endl;
+        }
+
+        if (result.lexError) status = 1;
+        else if (!result.errors.empty() && status == 0) status = 2;
+    }
+
+    return status;
+}
+
+// reads the N of an option like --max-depth=N, false unless it is a whole number above 0
+bool readCount(const std::string& digits, size_t& count) {
+    if (digits.empty() || digits.find_first_not_of("0123456789") != std::string::npos) return false;
+
+    try {
+        count = std::stoul(digits);
+    }
+    catch (const std::out_of_range&) {
+        return false;
+    }
+
+    return count > 0;
+}
+
+// usage: scrypt [--stream | --pipeline] [--engine=tree|vm] [--max-depth=N] [file]
+//        scrypt --check [file...]
+// a bad or unknown option, or a second file without --check, exits 2 without running anything
+int main(int argc, char* argv[]) {
+    bool streaming = false;
+    bool pipelined = false;
+    bool checking = false;
+    bool vm = false;
+    const char* path = nullptr;
+    std::vector<std::string> paths;
+
+    for (int i = 1; i < argc; i++) {
+        if (std::string(argv[i]) == "--stream") streaming = true;
+        else if (std::string(argv[i]) == "--pipeline") pipelined = true;
+        else if (std::string(argv[i]) == "--check") checking = true;
+        else if (std::string(argv[i]) == "--engine=vm") vm = true;
+        else if (std::string(argv[i]) == "--engine=tree") vm = false;
+        else if (std::string(argv[i]).rfind("--max-depth=", 0) == 0) {
+            if (!readCount(std::string(argv[i]).substr(12), maxCallDepth)) {
+                std::cerr << "scrypt: --max-depth needs a whole number of calls above 0, not " << argv[i] + 12 << std::endl;
+                return 2;
+            }
+        }
+        else if (std::string(argv[i]).rfind("--", 0) == 0) {
+            std::cerr << "scrypt: unknown option " << argv[i] << std::endl;
+            return 2;
+        }
+        else {
+            path = argv[i];
+            paths.push_back(argv[i]);
+        }
+    }
+
+    if (checking) return check(paths);
+
+    if (paths.size() > 1) {
+        std::cerr << "scrypt: runs one script at a time, only --check takes several" << std::endl;
+        return 2;
+    }
+
+    if (pipelined) {
+        // made first, the pipeline's parser thread uses it
+        Scrypt scrypt = Scrypt();
+        if (vm) scrypt.useVM();
+        if (std::thread::hardware_concurrency() > 1) scrypt.compileInBackground();
+        std::unique_ptr<Pipeline> pipeline;
+
+        try {
+            pipeline.reset(new Pipeline(path, scrypt));
+        }
+        catch (const std::exception& e) {
+          std::cout << e.what() << std::endl;
+          exit(1);
+        }
+
+        return stream(*pipeline, scrypt);
+    }
+
+    // outlives the tokens, see Lexer::sources
+    Lexer lexer = Lexer();
+
+    if (streaming) {
+        try {
+            if (path != nullptr) lexer.openStream(path);
+            else lexer.openStream();
+        }
+        catch (const std::exception& e) {
+          std::cout << e.what() << std::endl;
+          exit(1);
+        }
+
+        Scrypt scrypt = Scrypt();
+        if (vm) scrypt.useVM();
+        if (std::thread::hardware_concurrency() > 1) scrypt.compileInBackground();
+        return stream(lexer, scrypt);
+    }
 
-int main() {
     std::vector<Token> tokens;
     try {
-        Lexer lexer = Lexer();
-        tokens = lexer.lexer();
+        tokens = path != nullptr ? lexer.lexFile(path) : lexer.lexer();
     }
     catch (const std::exception& e) {
       std::cout << e.what() << std::endl;
@@ -20,8 +179,11 @@ int main() {
 
     try {
 	Scrypt scrypt = Scrypt();
-        std::map<std::string, Value> variables;
-        scrypt.parseBlock(tokens, variables, false);
+        if (vm) scrypt.useVM();
+        // def bodies are compiled on a spare core before they are called
+        if (std::thread::hardware_concurrency() > 1) scrypt.compileInBackground();
+        Env variables;
+        scrypt.parseBlock(tokens, variables, false, lexer.buffers());
     }
     catch (const std::exception& e) {
       std::cout << e.what() << std::endl;
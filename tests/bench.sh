@@ -0,0 +1,56 @@
+#!/bin/bash
+# Times a large generated script run whole, with --stream and with --pipeline, best of three runs each
+# every mode has to print the same thing, or the timings mean nothing
+#
+# usage: tests/bench.sh [path to the built scrypt, default ./scrypt] [statements, default 200000]
+# --pipeline only gains on more than one core, on one the threads just take turns
+
+scrypt=${1:-./scrypt}
+statements=${2:-200000}
+work=$(mktemp -d)
+trap 'rm -rf "$work"' EXIT
+
+if [ ! -x "$scrypt" ]; then
+    echo "no scrypt at $scrypt, build it first or pass its path"
+    exit 2
+fi
+
+# groups of six top level statements: arithmetic, arrays, an if, a loop and a call, with a def every 120 statements
+awk -v statements="$statements" 'BEGIN {
+    print "total = 0;"
+    print "values = [];"
+    for (i = 0; i < statements; i += 6) {
+        if (i % 120 == 0) printf "def step%d(x) {\n    return x * 3 + %d;\n}\n", i, i % 7
+        printf "a%d = (%d + total) * 2 - %d %% 7;\n", i % 50, i, i
+        printf "push(values, a%d / 2);\n", i % 50
+        printf "if a%d > %d {\n    total = total + 1;\n} else {\n    total = total - 1;\n}\n", i % 50, i
+        printf "j = 0;\nwhile j < 3 {\n    j = j + 1;\n}\n"
+        printf "total = total + step%d(j) - pop(values) * 0;\n", i - i % 120
+    }
+    print "print total;"
+}' > "$work/script.txt"
+
+echo "$statements statements, $(wc -c < "$work/script.txt") bytes"
+
+for engine in tree vm; do
+    if ! "$scrypt" --engine=$engine "$work/script.txt" > "$work/expected" 2>&1; then
+        echo "the generated script failed with --engine=$engine:"
+        tail -1 "$work/expected"
+        exit 1
+    fi
+
+    for mode in "" --stream --pipeline; do
+        best=
+        for run in 1 2 3; do
+            start=$(date +%s%N)
+            "$scrypt" --engine=$engine $mode "$work/script.txt" > "$work/output" 2>&1
+            took=$(( ($(date +%s%N) - start) / 1000000 ))
+            if ! cmp -s "$work/expected" "$work/output"; then
+                echo "--engine=$engine $mode printed something else than the whole file run"
+                exit 1
+            fi
+            if [ -z "$best" ] || [ $took -lt $best ]; then best=$took; fi
+        done
+        printf '  --engine=%-4s %-10s %6d ms\n' $engine "${mode:-whole}" $best
+    done
+done
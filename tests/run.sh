@@ -0,0 +1,72 @@
+#!/bin/bash
+# Runs every script in tests/scrypt with both engines, checks each against the expected output
+# and that --engine=tree and --engine=vm print the same thing
+#
+# usage: tests/run.sh [path to the built scrypt, default ./scrypt]
+#
+# NAME.txt is the script, or NAME.sh prints it when it is too big to keep in the tree
+# NAME.out is what it prints followed by a line "exit N" with its exit status
+# NAME.conf, if there is one, holds lines of (lines starting with # are comments)
+#   seconds N    the most either engine may take, 10 if not given
+#   memory KB    the most memory either engine may map, so a script that leaks runs out of it
+#   engines ...  the engines to run it with, when they are expected to differ (tree recurses on the C++ stack)
+#   args ...     extra arguments to scrypt
+
+scrypt=${1:-./scrypt}
+tests=$(cd "$(dirname "$0")" && pwd)/scrypt
+work=$(mktemp -d)
+trap 'rm -rf "$work"' EXIT
+
+if [ ! -x "$scrypt" ]; then
+    echo "no scrypt at $scrypt, build it first or pass its path"
+    exit 2
+fi
+
+failed=0
+count=0
+
+setting() {
+    [ -f "$tests/$1.conf" ] && sed -n "s/^$2 //p" "$tests/$1.conf"
+}
+
+for expected in "$tests"/*.out; do
+    name=$(basename "$expected" .out)
+    script=$tests/$name.txt
+    if [ ! -f "$script" ]; then
+        script=$work/$name.txt
+        bash "$tests/$name.sh" > "$script"
+    fi
+
+    seconds=$(setting "$name" seconds)
+    memory=$(setting "$name" memory)
+    engines=$(setting "$name" engines)
+    args=$(setting "$name" args)
+
+    outputs=()
+    for engine in ${engines:-tree vm}; do
+        output=$work/$name.$engine
+        (
+            [ -n "$memory" ] && ulimit -v "$memory"
+            timeout "${seconds:-10}" "$scrypt" --engine="$engine" $args "$script" > "$output" 2>&1
+            status=$?
+            [ $status = 124 ] && echo "timed out after ${seconds:-10} seconds" >> "$output"
+            echo "exit $status" >> "$output"
+        )
+
+        count=$((count + 1))
+        if ! diff -q "$expected" "$output" > /dev/null; then
+            echo "FAIL $name --engine=$engine"
+            diff "$expected" "$output" | head -20
+            failed=$((failed + 1))
+        fi
+        outputs+=("$output")
+    done
+
+    if [ ${#outputs[@]} = 2 ] && ! diff -q "${outputs[0]}" "${outputs[1]}" > /dev/null; then
+        echo "FAIL $name: the engines differ"
+        diff "${outputs[0]}" "${outputs[1]}" | head -20
+    fi
+done
+
+echo "$((count - failed)) of $count passed"
+[ $failed = 0 ]
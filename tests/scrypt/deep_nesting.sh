@@ -0,0 +1,11 @@
+# prints expressions nested 100000 parentheses deep
+# undefined is never set, so the right operands of | and & stop the script if they are evaluated
+n=100000
+repeat() {
+    printf '%*s' $n '' | sed "s/ /$1/g"
+}
+echo "x = $(repeat '(')1$(repeat ' + 1)');"
+echo "print x;"
+echo "print $(repeat '(')true$(repeat ' | undefined)');"
+echo "print $(repeat '(')false$(repeat ' \& undefined)');"
+echo "print $(repeat '(')x$(repeat ')') == x;"